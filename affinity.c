@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sched.h>
+#include <omp.h>
+#include "affinity.h"
+
+// Node directories looked at, nodes may be numbered with gaps
+#define MAX_NODE_IDS 256
+
+/*
+ * Thread placement over the NUMA nodes of the machine.
+ *
+ * The topology is read once from /sys/devices/system/node, keeping only the CPUs the
+ * process may run on; without it all of them form a single node. affinity_apply() pins every
+ * thread of a team to one CPU and records the node of the thread. With dynamic adjustment
+ * off, OpenMP keeps the threads of a team for later regions of the same size, so the pinning
+ * and the node hold for every search run on that team.
+ *
+ * Everything a thread allocates and writes first after it is pinned lands on its own node:
+ * the task board slabs of pool.c and the board and stack of a work-stealing worker are both
+ * allocated by the thread that uses them. The work-stealing pool keeps one list per node,
+ * see steal.c, so a hungry thread takes work from its own node before crossing to another.
+ */
+
+typedef struct {
+    int nodes;
+    int first[MAX_NODES + 1];   // CPUs of node n are cpus[first[n]] to cpus[first[n + 1] - 1]
+    int cpus[CPU_SETSIZE];
+    cpu_set_t allowed;
+} topology_t;
+
+static topology_t topology;
+static bool topology_read = false;
+
+static int local_node = 0;
+#pragma omp threadprivate(local_node)
+
+/**
+ * @brief Reads a CPU list like "0-3,8-11" from a sysfs file into a set.
+ *
+ * @return 1 on success, 0 if the file cannot be read.
+ */
+static int read_cpulist(const char *path, cpu_set_t *set) {
+    FILE *file = fopen(path, "r");
+    if(file == NULL) {
+        return 0;
+    }
+    CPU_ZERO(set);
+    int low;
+    int high;
+    int separator;
+    while(fscanf(file, "%d", &low) == 1) {
+        high = low;
+        separator = fgetc(file);
+        if(separator == '-') {
+            if(fscanf(file, "%d", &high) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+        for(int cpu = low; cpu <= high && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        if(separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+/**
+ * @brief Reads the topology on first use, see the comment at the top.
+ */
+static void topology_init(void) {
+    if(topology_read) {
+        return;
+    }
+    topology_read = true;
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &topology.allowed) != 0) {
+        CPU_ZERO(&topology.allowed);
+        CPU_SET(0, &topology.allowed);
+    }
+    cpu_set_t placed;
+    CPU_ZERO(&placed);
+    int n = 0;
+    topology.nodes = 0;
+    for(int id = 0; id < MAX_NODE_IDS; id++) {
+        char path[64];
+        cpu_set_t set;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        if(!read_cpulist(path, &set)) {
+            continue;
+        }
+        // Nodes past the table are folded into its last one
+        if(topology.nodes < MAX_NODES) {
+            topology.first[topology.nodes] = n;
+        }
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &set) && CPU_ISSET(cpu, &topology.allowed) && !CPU_ISSET(cpu, &placed)) {
+                CPU_SET(cpu, &placed);
+                topology.cpus[n++] = cpu;
+            }
+        }
+        // Nodes without a CPU of the process (memory only, or outside its mask) are skipped
+        if(topology.nodes < MAX_NODES && n > topology.first[topology.nodes]) {
+            topology.nodes++;
+        }
+    }
+    if(topology.nodes == 0) {
+        topology.first[0] = 0;
+        topology.nodes = 1;
+    }
+    // Allowed CPUs no node claimed go with the last node
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &topology.allowed) && !CPU_ISSET(cpu, &placed)) {
+            topology.cpus[n++] = cpu;
+        }
+    }
+    topology.first[topology.nodes] = n;
+}
+
+/**
+ * @brief Parses a placement policy: none, close or spread.
+ *
+ * @return true on success, false if the name is not a policy.
+ */
+bool affinity_parse(const char *name, affinity_t *policy) {
+    static const char *names[] = {"none", "close", "spread"};
+    for(int k = 0; k < 3; k++) {
+        if(strcmp(name, names[k]) == 0) {
+            *policy = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the number of NUMA nodes with CPUs the process may run on.
+ */
+int affinity_nodes(void) {
+    topology_init();
+    return topology.nodes;
+}
+
+/**
+ * @brief Returns the number of CPUs of a node the process may run on.
+ */
+int affinity_node_cpus(int node) {
+    topology_init();
+    return topology.first[node + 1] - topology.first[node];
+}
+
+/**
+ * @brief Pins the threads of a team of nthreads and records the node of every thread.
+ *
+ * Has to be called outside of a parallel region, with dynamic adjustment of the team size off
+ * and the team size the searches use, see the comment at the top. More threads than CPUs
+ * wrap around. AFFINITY_NONE lets the threads run anywhere again, all on node 0.
+ *
+ * @param policy The placement.
+ * @param nthreads The size of the team.
+ * @param nodes Only place threads on the first nodes nodes, 0 for all of them.
+ */
+void affinity_apply(affinity_t policy, int nthreads, int nodes) {
+    topology_init();
+    if(nodes <= 0 || nodes > topology.nodes) {
+        nodes = topology.nodes;
+    }
+    int ncpus = topology.first[nodes];
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int thread = omp_get_thread_num();
+        int node = 0;
+        cpu_set_t set = topology.allowed;
+        if(policy == AFFINITY_CLOSE) {
+            int k = thread % ncpus;
+            while(topology.first[node + 1] <= k) {
+                node++;
+            }
+            CPU_ZERO(&set);
+            CPU_SET(topology.cpus[k], &set);
+        } else if(policy == AFFINITY_SPREAD) {
+            node = thread % nodes;
+            int size = topology.first[node + 1] - topology.first[node];
+            CPU_ZERO(&set);
+            CPU_SET(topology.cpus[topology.first[node] + thread / nodes % size], &set);
+        }
+        if(sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0 && thread == 0) {
+            printf("Could not set thread affinity\n");
+        }
+        local_node = node;
+    }
+}
+
+/**
+ * @brief Returns the node the calling thread was pinned to by affinity_apply(), 0 if it was not.
+ */
+int affinity_node(void) {
+    return local_node;
+}
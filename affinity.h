@@ -0,0 +1,23 @@
+#include <stdbool.h>
+#include <stdint.h>
+#pragma once
+
+// NUMA nodes the topology keeps apart, CPUs of any further node count as the last one
+#define MAX_NODES 16
+
+// Where the threads of the team are pinned, see affinity_apply()
+typedef enum {
+    AFFINITY_NONE,          // Not pinned, the OS places and moves the threads
+    AFFINITY_CLOSE,         // Thread t on the t-th CPU, filling one node before the next
+    AFFINITY_SPREAD         // Threads dealt round robin over the nodes
+} affinity_t;
+
+bool affinity_parse(const char *name, affinity_t *policy);
+
+int affinity_nodes(void);
+
+int affinity_node_cpus(int node);
+
+void affinity_apply(affinity_t policy, int nthreads, int nodes);
+
+int affinity_node(void);
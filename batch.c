@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "batch.h"
+#include "loader.h"
+#include "percentile.h"
+
+#define MAX_CELLS 4096
+
+// Puzzles read ahead per thread before waiting for the window to finish
+#define BATCH_WINDOW 8
+
+// Nodes a puzzle is searched by one thread before the rest of the team is asked to help
+#define BATCH_SPLIT_NODES 2000
+
+typedef struct {
+    long index;
+    board_t board;
+    search_t search;
+    bool consistent;            // False if propagation on load already ruled the puzzle out
+    double latency;
+    ua_t ua[MAX_CELLS];
+    unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    int64_t rbits[MAX_SIDELENGTH];
+    int64_t cbits[MAX_SIDELENGTH];
+    int64_t bbits[MAX_SIDELENGTH];
+    int64_t filled[MAX_SIDELENGTH];
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
+} job_t;
+
+/**
+ * @brief Solves one puzzle of the batch, called as a task.
+ */
+static void solve_job(job_t *job, int cutoff) {
+    double time = omp_get_wtime();
+    short int zeroes = load_propagate(&job->board, job->ua);
+    job->consistent = zeroes >= 0;
+    if(job->consistent) {
+        run_engine(job->ua, &job->board, zeroes, cutoff);
+    }
+    job->latency = omp_get_wtime() - time;
+}
+
+/**
+ * @brief Writes the result of a puzzle as one line tagged with its index in the input.
+ *
+ * The line is "<index> solved <sidelength> <cells>" with the cells in row-major order,
+ * "<index> invalid" if the solution failed verification, or "<index> unsolvable". When
+ * counting it is "<index> solutions <count>", where a count equal to the limit means at least that many.
+ */
+static void print_job(job_t *job) {
+    if(job->board.opts->count) {
+        long solutions = job->consistent ? atomic_load(&job->search.solutions) : 0;
+        if(solutions > 0 && !job->search.valid) {
+            printf("%ld invalid\n", job->index);
+        } else {
+            printf("%ld solutions %ld\n", job->index, solutions);
+        }
+        return;
+    }
+    if(!job->consistent || !search_done(&job->search)) {
+        printf("%ld unsolvable\n", job->index);
+        return;
+    }
+    if(!job->search.valid) {
+        printf("%ld invalid\n", job->index);
+        return;
+    }
+    int sidelength = job->board.sidelength;
+    printf("%ld solved %d", job->index, sidelength);
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            printf(" %d", job->board.board[i][j]);
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Solves every puzzle of a file of boards in any of the formats of loader.c.
+ *
+ * One team of threads is kept for the whole batch. The reading thread hands every puzzle
+ * to a task, so easy puzzles run side by side on different threads. A puzzle that is still
+ * unsolved after BATCH_SPLIT_NODES nodes brings the threads that are free into its own
+ * work-stealing search (or spawns its own tasks with the cutoff and dlx engines).
+ *
+ * Results are printed to stdout in input order, one tagged line per puzzle, after every
+ * window of BATCH_WINDOW puzzles per thread. The throughput and the latency percentiles
+ * of the batch are printed to stderr at the end.
+ *
+ * @param source The opened file to read the puzzles from, from its current board on.
+ * @param opts The solver options used for every puzzle.
+ * @param nthreads The number of threads of the team.
+ * @param cutoff The task cutoff, only used by the cutoff scheduler.
+ *
+ * @return 1 if the whole file was read, 0 if a malformed board stopped the batch.
+ */
+int batch_run(source_t *source, const solver_opts_t *opts, int nthreads, int cutoff) {
+    solver_opts_t batch_opts = *opts;
+    if(batch_opts.split_nodes <= 0) {
+        batch_opts.split_nodes = BATCH_SPLIT_NODES;
+    }
+    int window = BATCH_WINDOW * nthreads;
+    job_t **jobs = malloc(sizeof(job_t *) * window);
+    long capacity = 1024;
+    double *latency = malloc(sizeof(double) * capacity);
+    if(jobs == NULL || latency == NULL) {
+        printf("Error allocating batch\n");
+        free(jobs);
+        free(latency);
+        return 0;
+    }
+
+    long n_puzzles = 0;
+    long n_solved = 0;
+    long n_latency = 0;
+    int status = 1;
+    double time = omp_get_wtime();
+    #pragma omp parallel num_threads(nthreads)
+    {
+        #pragma omp single
+        {
+            bool more = true;
+            while(more) {
+                int n_jobs = 0;
+                while(n_jobs < window) {
+                    job_t *job = malloc(sizeof(job_t));
+                    if(job == NULL) {
+                        printf("Error allocating batch\n");
+                        status = 0;
+                        more = false;
+                        break;
+                    }
+                    job->board.board = job->board_array;
+                    job->board.rbits = job->rbits;
+                    job->board.cbits = job->cbits;
+                    job->board.bbits = job->bbits;
+                    job->board.filled = tracks_filled(&batch_opts) ? job->filled : NULL;
+                    job->board.count = batch_opts.order != ORDER_FIXED ? job->count_array : NULL;
+                    job->board.tally = job->board.count != NULL ? job->tally_array : NULL;
+                    job->board.tally_rows = job->board.count != NULL ? job->tally_rows : NULL;
+                    job->board.opts = &batch_opts;
+                    job->board.search = &job->search;
+                    search_init(&job->search, true);
+                    int read = source_next(source, &job->board, job->ua);
+                    if(read != 1) {
+                        if(read == 0) {
+                            printf("Error reading puzzle %ld\n", n_puzzles);
+                            status = 0;
+                        }
+                        free(job);
+                        more = false;
+                        break;
+                    }
+                    job->index = n_puzzles++;
+                    jobs[n_jobs++] = job;
+                    #pragma omp task firstprivate(job)
+                    solve_job(job, cutoff);
+                }
+                #pragma omp taskwait
+
+                for(int k = 0; k < n_jobs; k++) {
+                    print_job(jobs[k]);
+                    n_solved += (search_done(&jobs[k]->search) || atomic_load(&jobs[k]->search.published)) && jobs[k]->search.valid;
+                    if(n_latency == capacity) {
+                        double *grown = realloc(latency, sizeof(double) * capacity * 2);
+                        if(grown != NULL) {
+                            latency = grown;
+                            capacity *= 2;
+                        }
+                    }
+                    if(n_latency < capacity) {
+                        latency[n_latency++] = jobs[k]->latency;
+                    }
+                    free(jobs[k]);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+    time = omp_get_wtime() - time;
+
+    fprintf(stderr, "Puzzles: %ld solved: %ld Nthreads: %d time taken: %f seconds (%.1f puzzles/s)\n",
+            n_puzzles, n_solved, nthreads, time, time > 0 ? n_puzzles / time : 0.0);
+    if(n_latency > 0) {
+        qsort(latency, n_latency, sizeof(double), compare_double);
+        fprintf(stderr, "Latency ms: p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+                percentile(latency, n_latency, 50) * 1e3, percentile(latency, n_latency, 90) * 1e3,
+                percentile(latency, n_latency, 99) * 1e3, latency[n_latency - 1] * 1e3);
+    }
+    free(jobs);
+    free(latency);
+    return status;
+}
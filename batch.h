@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "solver.h"
+#include "loader.h"
+#pragma once
+
+int batch_run(source_t *source, const solver_opts_t *opts, int nthreads, int cutoff);
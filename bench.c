@@ -0,0 +1,500 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include <omp.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "solver.h"
+#include "board.h"
+#include "kernels.h"
+#include "percentile.h"
+#include "stats.h"
+#include "affinity.h"
+
+#define MAX_CELLS 4096
+
+// Values one dimension of the parameter grid can take
+#define MAX_AXIS 16
+
+/*
+ * Benchmark harness, linked against solver.c built without its main.
+ *
+ * Every combination of the parameter grid given on the command line is run a number of
+ * warmup times, which are discarded, and then a number of measured times. A run loads
+ * the board, propagates and searches it; the loading is not timed. For each combination
+ * the min, median, 95th percentile, mean and standard deviation of the run times are
+ * reported with the nodes searched per second, as a table, CSV or JSON.
+ *
+ * The scaling mode (-N) replaces the thread counts by whole sockets: every combination is
+ * run on the CPUs of the first NUMA node, then of the first two and so on, with the threads
+ * pinned to them, and the node throughput is reported per socket and relative to one socket.
+ */
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} format_t;
+
+typedef struct {
+    int n;
+    int values[MAX_AXIS];
+} axis_t;
+
+typedef struct {
+    int size;
+    int nthreads;
+    int cutoff;         // 0 for work stealing
+    solver_opts_t opts;
+} config_t;
+
+typedef struct {
+    int runs;
+    int solved;         // Runs that published a valid solution
+    double min;
+    double median;
+    double p95;
+    double mean;
+    double stddev;
+    long nodes;         // Nodes of all measured runs
+    double nodes_per_second;
+} result_t;
+
+static const char *engine_names[] = {"bitmask", "dlx"};
+static const char *order_names[] = {"fixed", "mrv", "wdeg"};
+
+static int parse_size(const char *token) {
+    int size = atoi(token);
+    return size == 25 || size == 36 || size == 64 ? size : -1;
+}
+
+static int parse_threads(const char *token) {
+    int nthreads = atoi(token);
+    return nthreads >= 1 ? nthreads : -1;
+}
+
+static int parse_cutoff(const char *token) {
+    if(strcmp(token, "steal") == 0) {
+        return 0;
+    }
+    int cutoff = atoi(token);
+    return cutoff >= 0 && cutoff <= 500 ? cutoff : -1;
+}
+
+static int parse_engine(const char *token) {
+    for(int k = 0; k < 2; k++) {
+        if(strcmp(token, engine_names[k]) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static int parse_order(const char *token) {
+    for(int k = 0; k < 3; k++) {
+        if(strcmp(token, order_names[k]) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static int parse_flag(const char *token) {
+    return strcmp(token, "0") == 0 ? 0 : strcmp(token, "1") == 0 ? 1 : -1;
+}
+
+/**
+ * @brief Fills one dimension of the grid from a comma separated list.
+ *
+ * @param arg The list, modified by strtok().
+ * @param axis Output, the parsed values.
+ * @param parse Parses one entry, returns -1 if it is invalid.
+ *
+ * @return 1 on success, 0 if an entry is invalid, the list is empty or too long.
+ */
+static int parse_axis(char *arg, axis_t *axis, int (*parse)(const char *token)) {
+    axis->n = 0;
+    for(char *token = strtok(arg, ","); token != NULL; token = strtok(NULL, ",")) {
+        int value = parse(token);
+        if(value < 0 || axis->n == MAX_AXIS) {
+            return 0;
+        }
+        axis->values[axis->n++] = value;
+    }
+    return axis->n > 0;
+}
+
+/**
+ * @brief Loads the board of a configuration, solves it once and measures the search.
+ *
+ * @param config The configuration to run.
+ * @param time Output, the seconds spent in propagation and search.
+ * @param nodes Output, the nodes searched by all threads.
+ * @param solved Output, whether a valid solution was published.
+ *
+ * @return 1 on success, 0 if the board could not be loaded.
+ */
+static int run_once(const config_t *config, double *time, long *nodes, bool *solved) {
+    board_t board;
+    ua_t ua[MAX_CELLS];
+    unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    int64_t rbits[MAX_SIDELENGTH];
+    int64_t cbits[MAX_SIDELENGTH];
+    int64_t bbits[MAX_SIDELENGTH];
+    int64_t filled[MAX_SIDELENGTH];
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
+    search_t search;
+    search_init(&search, true);
+
+    board.board = board_array;
+    board.rbits = rbits;
+    board.cbits = cbits;
+    board.bbits = bbits;
+    board.filled = tracks_filled(&config->opts) ? filled : NULL;
+    board.count = config->opts.order != ORDER_FIXED ? count_array : NULL;
+    board.tally = board.count != NULL ? tally_array : NULL;
+    board.tally_rows = board.count != NULL ? tally_rows : NULL;
+    board.opts = &config->opts;
+    board.search = &search;
+    if(!board_init(config->size, &board, ua)) {
+        return 0;
+    }
+
+    stats_reset(config->nthreads);
+    double start = omp_get_wtime();
+    short int zeroes = load_propagate(&board, ua);
+    if(zeroes >= 0) {
+        #pragma omp parallel num_threads(config->nthreads)
+        {
+            #pragma omp single nowait
+            {
+                run_engine(ua, &board, zeroes, config->cutoff);
+            }
+        }
+    }
+    *time = omp_get_wtime() - start;
+    *nodes = stats_nodes(config->nthreads);
+    *solved = search_done(&search) && search.valid;
+    return 1;
+}
+
+/**
+ * @brief Runs a configuration warmups + runs times and summarizes the measured runs.
+ *
+ * @return 1 on success, 0 if the board could not be loaded.
+ */
+static int run_config(const config_t *config, int warmups, int runs, result_t *result) {
+    double times[runs];
+    double time;
+    long nodes;
+    bool solved;
+    for(int k = 0; k < warmups; k++) {
+        if(!run_once(config, &time, &nodes, &solved)) {
+            return 0;
+        }
+    }
+    memset(result, 0, sizeof(result_t));
+    result->runs = runs;
+    double total = 0;
+    for(int k = 0; k < runs; k++) {
+        if(!run_once(config, &times[k], &nodes, &solved)) {
+            return 0;
+        }
+        total += times[k];
+        result->nodes += nodes;
+        result->solved += solved;
+    }
+    qsort(times, runs, sizeof(double), compare_double);
+    result->min = times[0];
+    result->median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    result->p95 = percentile(times, runs, 95);
+    result->mean = total / runs;
+    double squares = 0;
+    for(int k = 0; k < runs; k++) {
+        squares += (times[k] - result->mean) * (times[k] - result->mean);
+    }
+    result->stddev = runs > 1 ? sqrt(squares / (runs - 1)) : 0;
+    result->nodes_per_second = total > 0 ? result->nodes / total : 0;
+    return 1;
+}
+
+/**
+ * @brief Prints the header of the table or the CSV, or opens the JSON array.
+ */
+static void print_header(format_t format) {
+    if(format == FORMAT_TEXT) {
+        printf("%4s %7s %7s %5s %4s %6s %6s %5s %9s %9s %9s %9s %9s %12s\n", "size", "threads", "engine", "order",
+               "prop", "sched", "kernel", "ok", "min_s", "median_s", "p95_s", "mean_s", "stddev_s", "nodes/s");
+    } else if(format == FORMAT_CSV) {
+        printf("size,threads,engine,order,propagate,scheduler,cutoff,kernel,runs,solved,min_s,median_s,p95_s,mean_s,stddev_s,nodes,nodes_per_s\n");
+    } else {
+        printf("[");
+    }
+}
+
+/**
+ * @brief Prints the header of the scaling table or CSV, or opens the JSON array.
+ */
+static void print_scaling_header(format_t format) {
+    if(format == FORMAT_TEXT) {
+        printf("%4s %7s %5s %4s %6s %7s %7s %5s %9s %12s %12s %7s\n", "size", "engine", "order", "prop", "sched",
+               "sockets", "threads", "ok", "median_s", "nodes/s", "per_socket", "scaling");
+    } else if(format == FORMAT_CSV) {
+        printf("size,engine,order,propagate,scheduler,cutoff,sockets,threads,runs,solved,median_s,nodes,nodes_per_s,nodes_per_s_per_socket,scaling\n");
+    } else {
+        printf("[");
+    }
+}
+
+/**
+ * @brief Prints one row of the scaling mode.
+ *
+ * @param sockets The number of NUMA nodes the threads were pinned to.
+ * @param single The nodes per second on one socket, the base of the scaling column.
+ */
+static void print_scaling(format_t format, const config_t *config, const result_t *result, int sockets, double single, bool first) {
+    const char *engine = engine_names[config->opts.engine];
+    const char *order = order_names[config->opts.order];
+    const char *scheduler = config->cutoff > 0 ? "cutoff" : "steal";
+    double per_socket = result->nodes_per_second / sockets;
+    double scaling = single > 0 ? result->nodes_per_second / single : 0;
+    if(format == FORMAT_TEXT) {
+        char sched[16];
+        if(config->cutoff > 0) {
+            snprintf(sched, sizeof(sched), "%d", config->cutoff);
+        } else {
+            snprintf(sched, sizeof(sched), "steal");
+        }
+        printf("%4d %7s %5s %4d %6s %7d %7d %2d/%-2d %9.6f %12.0f %12.0f %6.2fx\n", config->size, engine, order,
+               config->opts.propagate, sched, sockets, config->nthreads, result->solved, result->runs, result->median,
+               result->nodes_per_second, per_socket, scaling);
+    } else if(format == FORMAT_CSV) {
+        printf("%d,%s,%s,%d,%s,%d,%d,%d,%d,%d,%.6f,%ld,%.0f,%.0f,%.3f\n", config->size, engine, order,
+               config->opts.propagate, scheduler, config->cutoff, sockets, config->nthreads, result->runs,
+               result->solved, result->median, result->nodes, result->nodes_per_second, per_socket, scaling);
+    } else {
+        printf("%s\n  {\"size\": %d, \"engine\": \"%s\", \"order\": \"%s\", \"propagate\": %s, \"scheduler\": \"%s\", "
+               "\"cutoff\": %d, \"sockets\": %d, \"threads\": %d, \"runs\": %d, \"solved\": %d, \"median_s\": %.6f, "
+               "\"nodes\": %ld, \"nodes_per_s\": %.0f, \"nodes_per_s_per_socket\": %.0f, \"scaling\": %.3f}",
+               first ? "" : ",", config->size, engine, order, config->opts.propagate ? "true" : "false", scheduler,
+               config->cutoff, sockets, config->nthreads, result->runs, result->solved, result->median, result->nodes,
+               result->nodes_per_second, per_socket, scaling);
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Prints the result of one configuration in the chosen format.
+ */
+static void print_result(format_t format, const config_t *config, const result_t *result, bool first) {
+    const char *engine = engine_names[config->opts.engine];
+    const char *order = order_names[config->opts.order];
+    const char *scheduler = config->cutoff > 0 ? "cutoff" : "steal";
+    if(format == FORMAT_TEXT) {
+        char sched[16];
+        if(config->cutoff > 0) {
+            snprintf(sched, sizeof(sched), "%d", config->cutoff);
+        } else {
+            snprintf(sched, sizeof(sched), "steal");
+        }
+        printf("%4d %7d %7s %5s %4d %6s %6s %2d/%-2d %8.6f %9.6f %9.6f %9.6f %9.6f %12.0f\n", config->size, config->nthreads,
+               engine, order, config->opts.propagate, sched, kernel_name(), result->solved, result->runs, result->min,
+               result->median, result->p95, result->mean, result->stddev, result->nodes_per_second);
+    } else if(format == FORMAT_CSV) {
+        printf("%d,%d,%s,%s,%d,%s,%d,%s,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%ld,%.0f\n", config->size, config->nthreads,
+               engine, order, config->opts.propagate, scheduler, config->cutoff, kernel_name(), result->runs,
+               result->solved, result->min, result->median, result->p95, result->mean, result->stddev, result->nodes,
+               result->nodes_per_second);
+    } else {
+        printf("%s\n  {\"size\": %d, \"threads\": %d, \"engine\": \"%s\", \"order\": \"%s\", \"propagate\": %s, "
+               "\"scheduler\": \"%s\", \"cutoff\": %d, \"kernel\": \"%s\", \"runs\": %d, \"solved\": %d, "
+               "\"min_s\": %.6f, \"median_s\": %.6f, \"p95_s\": %.6f, \"mean_s\": %.6f, \"stddev_s\": %.6f, "
+               "\"nodes\": %ld, \"nodes_per_s\": %.0f}", first ? "" : ",", config->size, config->nthreads, engine, order,
+               config->opts.propagate ? "true" : "false", scheduler, config->cutoff, kernel_name(), result->runs,
+               result->solved, result->min, result->median, result->p95, result->mean, result->stddev, result->nodes,
+               result->nodes_per_second);
+    }
+    fflush(stdout);
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [-s sizes] [-t threads|-N] [-c cutoffs] [-e engines] [-o orders] [-p flags] [-k kernel] [-a none|close|spread] [-w warmups] [-r runs] [-f text|csv|json]\n", name);
+    printf("Every list is comma separated and every combination of them is run.\n");
+    printf("-s: board sizes, 25, 36 or 64 (default 25,36,64)\n");
+    printf("-t: thread counts (default 1,2,4)\n");
+    printf("-c: cutoffs of the cutoff scheduler (max 500), steal or 0 for work stealing (default steal)\n");
+    printf("-e: engines, bitmask or dlx (default bitmask)\n");
+    printf("-o: cell orders, fixed, mrv or wdeg (default mrv)\n");
+    printf("-p: propagation, 0 or 1 (default 0)\n");
+    printf("-k: candidate kernel, auto, avx512, avx2 or scalar (default auto)\n");
+    printf("-a: thread placement, none, close (filling one NUMA node first) or spread (round robin over the nodes), default none, close with -N\n");
+    printf("-N: socket scaling, run on every CPU of the first 1, 2, ... NUMA nodes instead of the thread counts\n");
+    printf("-w: warmup runs per combination, not measured (default 1)\n");
+    printf("-r: measured runs per combination (default 5)\n");
+    printf("-f: output format, text (default), csv or json\n");
+}
+
+int main(int argc, char *argv[]) {
+    char default_sizes[] = "25,36,64";
+    char default_threads[] = "1,2,4";
+    char default_cutoffs[] = "steal";
+    char default_engines[] = "bitmask";
+    char default_orders[] = "mrv";
+    char default_flags[] = "0";
+    char *lists[6] = {default_sizes, default_threads, default_cutoffs, default_engines, default_orders, default_flags};
+    char *kernel = "auto";
+    affinity_t affinity = AFFINITY_NONE;
+    bool placed = false;
+    bool scaling = false;
+    int warmups = 1;
+    int runs = 5;
+    format_t format = FORMAT_TEXT;
+    int opt;
+    while((opt = getopt(argc, argv, "s:t:c:e:o:p:k:a:Nw:r:f:")) != -1) {
+        switch(opt) {
+            case 's':
+                lists[0] = optarg;
+                break;
+            case 't':
+                lists[1] = optarg;
+                break;
+            case 'c':
+                lists[2] = optarg;
+                break;
+            case 'e':
+                lists[3] = optarg;
+                break;
+            case 'o':
+                lists[4] = optarg;
+                break;
+            case 'p':
+                lists[5] = optarg;
+                break;
+            case 'k':
+                kernel = optarg;
+                break;
+            case 'a':
+                if(!affinity_parse(optarg, &affinity)) {
+                    printf("Invalid thread placement: %s\n", optarg);
+                    return 1;
+                }
+                placed = true;
+                break;
+            case 'N':
+                scaling = true;
+                break;
+            case 'w':
+                warmups = atoi(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 'f':
+                if(strcmp(optarg, "text") == 0) {
+                    format = FORMAT_TEXT;
+                } else if(strcmp(optarg, "csv") == 0) {
+                    format = FORMAT_CSV;
+                } else if(strcmp(optarg, "json") == 0) {
+                    format = FORMAT_JSON;
+                } else {
+                    printf("Invalid format: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(optind != argc || warmups < 0 || runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *names[6] = {"sizes", "threads", "cutoffs", "engines", "orders", "propagation flags"};
+    int (*parsers[6])(const char *token) = {parse_size, parse_threads, parse_cutoff, parse_engine, parse_order, parse_flag};
+    axis_t axes[6];
+    for(int a = 0; a < 6; a++) {
+        if(!parse_axis(lists[a], &axes[a], parsers[a])) {
+            printf("Invalid %s\n", names[a]);
+            return 1;
+        }
+    }
+    if(!kernel_select(kernel)) {
+        printf("Unsupported kernel: %s\n", kernel);
+        return 1;
+    }
+    // The node counters are threadprivate and need every region to get the requested team size
+    omp_set_dynamic(0);
+    int sockets = affinity_nodes();
+    if(scaling) {
+        // One run per socket count stands in for the thread counts
+        axes[1].n = 1;
+        if(!placed) {
+            affinity = AFFINITY_CLOSE;
+        }
+    }
+
+    if(scaling) {
+        print_scaling_header(format);
+    } else {
+        print_header(format);
+    }
+    // Nesting of the axes from the outermost to the innermost loop, threads vary fastest
+    const int nesting[6] = {0, 3, 4, 5, 2, 1};
+    long n_configs = 1;
+    for(int a = 0; a < 6; a++) {
+        n_configs *= axes[a].n;
+    }
+    for(long k = 0; k < n_configs; k++) {
+        int value[6];
+        long rest = k;
+        for(int a = 5; a >= 0; a--) {
+            value[nesting[a]] = axes[nesting[a]].values[rest % axes[nesting[a]].n];
+            rest /= axes[nesting[a]].n;
+        }
+        config_t config = {0};
+        config.size = value[0];
+        config.nthreads = value[1];
+        config.cutoff = value[2];
+        config.opts.engine = value[3];
+        config.opts.scheduler = config.cutoff > 0 ? SCHED_CUTOFF : SCHED_STEAL;
+        config.opts.order = value[4];
+        config.opts.propagate = value[5];
+        config.opts.split_nodes = 0;
+        result_t result;
+        if(scaling) {
+            double single = 0;
+            config.nthreads = 0;
+            for(int n = 1; n <= sockets; n++) {
+                config.nthreads += affinity_node_cpus(n - 1);
+                affinity_apply(affinity, config.nthreads, n);
+                if(!run_config(&config, warmups, runs, &result)) {
+                    printf("Error initializing board\n");
+                    return 1;
+                }
+                if(n == 1) {
+                    single = result.nodes_per_second;
+                }
+                print_scaling(format, &config, &result, n, single, k == 0 && n == 1);
+            }
+            continue;
+        }
+        if(placed) {
+            affinity_apply(affinity, config.nthreads, 0);
+        }
+        if(!run_config(&config, warmups, runs, &result)) {
+            printf("Error initializing board\n");
+            return 1;
+        }
+        print_result(format, &config, &result, k == 0);
+    }
+    if(format == FORMAT_JSON) {
+        printf("\n]\n");
+    }
+    return 0;
+}
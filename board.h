@@ -0,0 +1,434 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "solver.h"
+#pragma once
+
+/*
+ * Small board primitives shared by the solver, the propagation pass and the other engines.
+ * They are static inline so every translation unit gets its own copy in the hot loops.
+ *
+ * The primitives that depend on the base also come in a _base form taking it as an argument.
+ * Inlined into a search instantiated for a constant base (see SPECIALIZED_BASES) the divisions
+ * by the base become multiplies and the loops over a block row are fully unrolled.
+ */
+
+// Bases with a search specialized at compile time, other bases use the generic search
+#define SPECIALIZED_BASES(X) X(3) X(4) X(5) X(6) X(8)
+
+/**
+ * @brief Returns whether some board copy of the search already published a solution.
+ *
+ * The flag is written once, so its cache line stays shared until then and the relaxed
+ * load is a plain load that can be polled on every node.
+ */
+static inline bool search_done(const search_t *search) {
+    return atomic_load_explicit(&search->found, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the index of the block containing (row, column) on a board of the given base.
+ */
+static inline int block_index_base(int base, int row, int column) {
+    return (row / base) * base + (column / base);
+}
+
+/**
+ * @brief Returns the index of the block containing (row, column).
+ */
+static inline int block_index(const board_t *board, int row, int column) {
+    return block_index_base(board->base, row, column);
+}
+
+/**
+ * @brief Returns the mask with one bit set for every value 1..sidelength.
+ */
+static inline uint64_t full_mask(int sidelength) {
+    return sidelength == 64 ? ~(uint64_t)0 : ((uint64_t)1 << sidelength) - 1;
+}
+
+/**
+ * @brief Returns the number of bytes of a grid that a board of the given size uses.
+ *
+ * Rows are MAX_SIDELENGTH apart, so this is every full row but the last plus the cells
+ * of the last one, and the whole used part can be moved with one memcpy.
+ */
+static inline size_t grid_bytes(int sidelength) {
+    return (size_t)(sidelength - 1) * MAX_SIDELENGTH + sidelength;
+}
+
+/**
+ * @brief Returns the number of bytes of board->tally that a board of the given size uses, see grid_bytes().
+ *
+ * A row of the tally has a slot for every count from 0 to sidelength.
+ */
+static inline size_t tally_bytes(int sidelength) {
+    return (size_t)(sidelength - 1) * (MAX_SIDELENGTH + 1) + sidelength + 1;
+}
+
+/**
+ * @brief Returns whether a search with the options reads which cells are filled, see cell_empty().
+ *
+ * Propagation and the MRV and dom/wdeg scans do. The fixed order without propagation branches
+ * on ua[zeroes-1] and never looks, so its boards leave board->filled NULL and skip its upkeep.
+ */
+static inline bool tracks_filled(const solver_opts_t *opts) {
+    return opts->propagate || opts->order != ORDER_FIXED;
+}
+
+/**
+ * @brief Copies the bitmasks, the filled cells and the candidate counts of src into the buffers of dst.
+ *
+ * Only the part sized to the board is copied, 800 bytes of masks for a 25x25 board instead of
+ * the 2 KiB of the full buffers. The cells are not, every board of a search shares the grid it
+ * started from and report_solution() puts the values placed since together from the path of
+ * the board, the thread's trail and board->cells. The filled cells and the counts, with the
+ * tally of the empty cells by count, are copied when both boards track them.
+ */
+static inline void board_copy(board_t *dst, const board_t *src) {
+    int sidelength = src->sidelength;
+    memcpy(dst->rbits, src->rbits, sizeof(int64_t) * sidelength);
+    memcpy(dst->cbits, src->cbits, sizeof(int64_t) * sidelength);
+    memcpy(dst->bbits, src->bbits, sizeof(int64_t) * sidelength);
+    if(dst->filled != NULL && src->filled != NULL) {
+        memcpy(dst->filled, src->filled, sizeof(int64_t) * sidelength);
+    }
+    if(dst->count != NULL && src->count != NULL) {
+        memcpy(dst->count, src->count, grid_bytes(sidelength));
+        memcpy(dst->tally, src->tally, tally_bytes(sidelength));
+        memcpy(dst->tally_rows, src->tally_rows, sizeof(uint64_t) * (sidelength + 1));
+    }
+}
+
+/**
+ * @brief Returns whether (row, column) is still empty on the board.
+ */
+static inline bool cell_empty(const board_t *board, int row, int column) {
+    return !(board->filled[row] & COLUMN_BIT(column));
+}
+
+/**
+ * @brief Returns the values that can still be placed in (row, column) as a bitmask, for a board of the given base.
+ */
+static inline uint64_t candidates_base(const board_t *board, int base, int row, int column) {
+    uint64_t used = board->rbits[row] | board->cbits[column] | board->bbits[block_index_base(base, row, column)];
+    return ~used & full_mask(base * base);
+}
+
+/**
+ * @brief Returns the values that can still be placed in (row, column) as a bitmask.
+ */
+static inline uint64_t candidates(const board_t *board, int row, int column) {
+    return candidates_base(board, board->base, row, column);
+}
+
+/**
+ * @brief Adds delta empty cells of the row to the tally of the given candidate count.
+ */
+static inline void tally_add(board_t *board, int row, int count, int delta) {
+    if((board->tally[row][count] += delta) != 0) {
+        board->tally_rows[count] |= ROW_BIT(row);
+    } else {
+        board->tally_rows[count] &= ~ROW_BIT(row);
+    }
+}
+
+/**
+ * @brief Changes the candidate count of (row, column) by delta, an empty cell moves to the tally of its new count.
+ */
+static inline void count_change(board_t *board, int row, int column, int delta) {
+    int count = board->count[row][column];
+    board->count[row][column] = count + delta;
+    if(cell_empty(board, row, column)) {
+        tally_add(board, row, count, -1);
+        tally_add(board, row, count + delta, 1);
+    }
+}
+
+/**
+ * @brief Sets the candidate count of every cell from the masks and builds the tally of the empty cells.
+ *
+ * The count of a cell is the number of values still allowed by its row, column and block, also
+ * for a filled cell, see count_update_base(). Needs board->filled.
+ */
+static inline void count_init(board_t *board) {
+    int base = board->base;
+    int sidelength = board->sidelength;
+    uint64_t full = full_mask(sidelength);
+    memset(board->tally, 0, tally_bytes(sidelength));
+    memset(board->tally_rows, 0, sizeof(uint64_t) * (sidelength + 1));
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            uint64_t used = board->rbits[i] | board->cbits[j] | board->bbits[block_index_base(base, i, j)];
+            board->count[i][j] = __builtin_popcountll(~used & full);
+            if(cell_empty(board, i, j)) {
+                tally_add(board, i, board->count[i][j], 1);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adjusts the candidate counts of every cell that shares a unit with (row, column).
+ *
+ * A cell gains or loses the value as a candidate only if neither of its other units
+ * already contain it, so each peer is checked against its own row, column and block masks.
+ * The check has to run while the value is absent from the masks of (row, column), i.e.
+ * before it is added and after it is removed. The cell itself is counted as well so that
+ * the counts stay exact for every cell, assigned or not. The empty cells among them move
+ * between the tallies of their old and new count, see select_cell().
+ *
+ * @param board Pointer to the Sudoku board structure.
+ * @param base The base of the board.
+ * @param row The row index of the updated cell.
+ * @param column The column index of the updated cell.
+ * @param mask The bitmask of the value being placed or removed.
+ * @param delta -1 when the value is placed, +1 when it is removed.
+ */
+static inline void count_update_base(board_t *board, int base, int row, int column, int64_t mask, int delta) {
+    int sidelength = base * base;
+    int start_row = row - row % base;
+    int start_column = column - column % base;
+    // Same row, including the cell itself, walked block by block so no division is needed per cell
+    for(int block = start_row, start = 0; start < sidelength; block++, start += base) {
+        int64_t block_bits = board->bbits[block];
+        for(int j = start; j < start + base; j++) {
+            if(!((board->cbits[j] | block_bits) & mask)) {
+                count_change(board, row, j, delta);
+            }
+        }
+    }
+    // Same column
+    for(int block = column / base, start = 0; start < sidelength; block += base, start += base) {
+        int64_t block_bits = board->bbits[block];
+        for(int i = start; i < start + base; i++) {
+            if(i != row && !((board->rbits[i] | block_bits) & mask)) {
+                count_change(board, i, column, delta);
+            }
+        }
+    }
+    // Rest of the block, the row and column of the cell were handled above
+    for(int i = start_row; i < start_row + base; i++) {
+        if(i == row) {
+            continue;
+        }
+        for(int j = start_column; j < start_column + base; j++) {
+            if(j == column) {
+                continue;
+            }
+            if(!((board->rbits[i] | board->cbits[j]) & mask)) {
+                count_change(board, i, j, delta);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Updates the bitmask representation of the Sudoku board for a specific cell.
+ *
+ * This function modifies the bitmasks associated with rows, columns, and blocks
+ * in the Sudoku board to either add or remove a specific value. The bitmasks are
+ * used to efficiently track which numbers are present in each row, column, and block,
+ * and the mask of the filled cells of the row which cells hold one at all, when the board
+ * tracks it. When the board tracks candidate counts they are updated incrementally as well,
+ * with the tally of the empty cells by count.
+ *
+ * @param board Pointer to the Sudoku board structure.
+ * @param base The base of the board.
+ * @param row The row index of the cell to update.
+ * @param column The column index of the cell to update.
+ * @param value The value to add or remove from the bitmasks.
+ * @param add A boolean flag indicating the operation to perform (true for add, false for remove).
+ *
+ */
+static inline void bit_update_base(board_t *board, int base, int row, int column, int value, bool add) {
+    int curr_block = block_index_base(base, row, column);
+    int64_t mask = VALUE_BIT(value);
+    if(add) {
+        if(board->count != NULL) {
+            count_update_base(board, base, row, column, mask, -1);
+        }
+        // Add the value to the bitmasks using the OR operator
+        board->rbits[row] |= mask;
+        board->cbits[column] |= mask;
+        board->bbits[curr_block] |= mask;
+        if(board->filled != NULL) {
+            board->filled[row] |= COLUMN_BIT(column);
+        }
+        if(board->count != NULL) {
+            // The cell is filled now and leaves the tally
+            tally_add(board, row, board->count[row][column], -1);
+        }
+    } else {
+        // Remove the value from the bitmasks using the NOT operator
+        board->rbits[row] &= ~mask;
+        board->cbits[column] &= ~mask;
+        board->bbits[curr_block] &= ~mask;
+        if(board->filled != NULL) {
+            board->filled[row] &= ~COLUMN_BIT(column);
+        }
+        if(board->count != NULL) {
+            tally_add(board, row, board->count[row][column], 1);
+            count_update_base(board, base, row, column, mask, 1);
+        }
+    }
+}
+
+/**
+ * @brief Updates the bitmasks and candidate counts for a cell, see bit_update_base().
+ */
+static inline void bit_update(board_t *board, int row, int column, int value, bool add) {
+    bit_update_base(board, board->base, row, column, value, add);
+}
+
+/**
+ * @brief Returns a well mixed 64 bit hash of x, the splitmix64 finalizer.
+ */
+static inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Returns the candidate of (row, column) to try next under the value order of the options.
+ *
+ * The choice only depends on the cell and the mask, so a loop or a stack frame that clears
+ * the value it took gets the rest in the same order, whoever continues it.
+ *
+ * @param board The board.
+ * @param cand The values not tried yet, not 0.
+ * @param row The row of the cell.
+ * @param column The column of the cell.
+ */
+static inline int next_value(const board_t *board, uint64_t cand, int row, int column) {
+    switch(board->opts->values) {
+        case VALUES_HIGH:
+            return 64 - __builtin_clzll(cand);
+        case VALUES_RANDOM: {
+            int start = mix64(board->opts->seed + row * MAX_SIDELENGTH + column) % board->sidelength;
+            uint64_t above = cand & (~(uint64_t)0 << start);
+            return __builtin_ctzll(above != 0 ? above : cand) + 1;
+        }
+        default:
+            return __builtin_ctzll(cand) + 1;
+    }
+}
+
+/**
+ * @brief Returns the first column in [from, to) of an empty cell of the row with count candidates, -1 for none.
+ */
+static inline int tally_column(const board_t *board, int row, int count, int from, int to) {
+    for(int j = from; j < to; j++) {
+        if(board->count[row][j] == count && cell_empty(board, row, j)) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Picks an empty cell with the fewest candidates from the tally, see select_cell().
+ *
+ * The fewest count is the lowest one with rows in board->tally_rows, and only one row holding
+ * it is scanned for the cell. The cell is the first one in ua order from first on, wrapping
+ * around, which is the cell a scan of ua starting at first would settle on.
+ *
+ * @param first The empty cell the scan starts at.
+ *
+ * @return The candidate count of the cell.
+ */
+static inline int pick_fewest(const board_t *board, ua_t first, ua_t *cell) {
+    int sidelength = board->sidelength;
+    int count = 0;
+    while(count < sidelength && board->tally_rows[count] == 0) {
+        count++;
+    }
+    uint64_t rows = board->tally_rows[count];
+    int row = first.x;
+    int column = rows & ROW_BIT(row) ? tally_column(board, row, count, first.y, sidelength) : -1;
+    if(column < 0) {
+        uint64_t after = rows & (~(uint64_t)1 << row);
+        uint64_t before = rows & (ROW_BIT(row) - 1);
+        if(after != 0 || before != 0) {
+            row = __builtin_ctzll(after != 0 ? after : before);
+            column = tally_column(board, row, count, 0, sidelength);
+        } else {
+            column = tally_column(board, row, count, 0, first.y);
+        }
+    }
+    cell->x = row;
+    cell->y = column;
+    return count;
+}
+
+/**
+ * @brief Scans ua[from..to) for an empty cell with a lower dom/wdeg score than the best so far.
+ *
+ * The score is the candidate count over one plus the conflict weight of the cell, compared
+ * by cross multiplying so that no division is needed. A cell with at most one candidate
+ * still ends the scan, forced cells go first whatever their weight.
+ *
+ * @param best Count of the best cell so far, MAX_SIDELENGTH + 1 for none.
+ * @param best_weight Weight of the best cell so far, updated with it.
+ */
+static inline int scan_weighted(ua_t *ua, board_t *board, int from, int to, int best, unsigned int *best_weight, ua_t *cell) {
+    for(int k = from; k < to && best > 1; k++) {
+        ua_t curr = ua[k];
+        if(!cell_empty(board, curr.x, curr.y)) {
+            continue;
+        }
+        int curr_count = board->count[curr.x][curr.y];
+        unsigned int curr_weight = board->restart->weight[curr.x][curr.y] + 1;
+        if(curr_count <= 1 || (uint64_t)curr_count * *best_weight < (uint64_t)best * curr_weight) {
+            best = curr_count;
+            *best_weight = curr_weight;
+            *cell = curr;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Picks the empty cell the solver should branch on next.
+ *
+ * With ORDER_FIXED this is ua[zeroes-1], which is the reverse file order of the empty cells.
+ * Propagation fills cells out of that order, so with it enabled the last empty entry of ua is taken.
+ * With ORDER_MRV the cell is one with the fewest candidates according to the incrementally
+ * maintained board->count. The empty cells are kept in board->tally by row and count, so the
+ * lowest count is found from board->tally_rows and only a row holding it is scanned, see
+ * pick_fewest(). Of the cells with that count the first in ua order is taken, and with a
+ * seed the order starts at an entry of ua drawn from it and wraps around, so searches with
+ * different seeds break ties between cells differently. ORDER_WDEG divides the counts by
+ * the conflict weights of the restarting search running on the board, see scan_weighted(),
+ * and falls back to MRV where there is none.
+ *
+ * @param ua The array of unassigned cells built by board_init().
+ * @param board Pointer to the Sudoku board structure.
+ * @param zeroes The number of empty cells left.
+ * @param cell Output, the chosen cell.
+ *
+ * @return false if some empty cell has no candidates left, meaning the branch is dead.
+ */
+static inline bool select_cell(ua_t *ua, board_t *board, short int zeroes, ua_t *cell) {
+    if(board->opts->order == ORDER_FIXED) {
+        if(!board->opts->propagate) {
+            *cell = ua[zeroes - 1];
+            return true;
+        }
+        int k = board->n_zeros - 1;
+        while(!cell_empty(board, ua[k].x, ua[k].y)) {
+            k--;
+        }
+        *cell = ua[k];
+        return true;
+    }
+    int start = board->opts->seed != 0 ? mix64(board->opts->seed) % board->n_zeros : 0;
+    if(board->opts->order == ORDER_WDEG && board->restart != NULL) {
+        unsigned int weight = 1;
+        int best = scan_weighted(ua, board, start, board->n_zeros, MAX_SIDELENGTH + 1, &weight, cell);
+        best = scan_weighted(ua, board, 0, start, best, &weight, cell);
+        return best > 0;
+    }
+    return pick_fewest(board, ua[start], cell) > 0;
+}
@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#include "board.h"
+#include "canon.h"
+
+#define MAX_BASE 8
+
+// Rounds of key refinement between the rows, the columns and the values
+#define CANON_ROUNDS 3
+
+/*
+ * Canonical form of a puzzle under the symmetries that map puzzles to puzzles with the same
+ * number of solutions: relabeling the values, permuting the bands, the rows inside a band,
+ * the stacks and the columns inside a stack, and transposing.
+ *
+ * Every row, column and value gets a key that does not depend on the labels or the order
+ * of the lines: it starts as the number of givens and is refined a few rounds from the keys
+ * of the lines and values its givens meet, like color refinement on a graph. The bands and
+ * stacks are then sorted by the sum of the keys of their lines, the lines inside by their
+ * own key, and the values relabeled in the order they first appear. Both orientations are
+ * built and the smaller grid is the canonical form.
+ *
+ * Lines with equal keys keep their input order, so two equivalent puzzles can still get
+ * different forms, which only costs a cache miss. Every form is a symmetry of its puzzle,
+ * so equal forms always mean equivalent puzzles: the cache compares the whole form, and the
+ * hash only picks the slot.
+ */
+
+/**
+ * @brief Fills the keys of the rows and the columns of a grid, see the comment at the top.
+ */
+static void refine(unsigned char (*grid)[MAX_SIDELENGTH], int sidelength, uint64_t *rkey, uint64_t *ckey) {
+    uint64_t vkey[MAX_SIDELENGTH + 1] = {0};
+    uint64_t rnext[MAX_SIDELENGTH];
+    uint64_t cnext[MAX_SIDELENGTH];
+    uint64_t vnext[MAX_SIDELENGTH + 1];
+    memset(rkey, 0, sizeof(uint64_t) * sidelength);
+    memset(ckey, 0, sizeof(uint64_t) * sidelength);
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            int value = grid[i][j];
+            rkey[i] += value != 0;
+            ckey[j] += value != 0;
+            vkey[value] += value != 0;
+        }
+    }
+    for(int round = 0; round < CANON_ROUNDS; round++) {
+        memset(rnext, 0, sizeof(uint64_t) * sidelength);
+        memset(cnext, 0, sizeof(uint64_t) * sidelength);
+        memset(vnext, 0, sizeof(uint64_t) * (sidelength + 1));
+        // Sums of mixed keys do not depend on the order the givens are visited in
+        for(int i = 0; i < sidelength; i++) {
+            for(int j = 0; j < sidelength; j++) {
+                int value = grid[i][j];
+                if(value != 0) {
+                    rnext[i] += mix64(ckey[j] * 0x9e3779b97f4a7c15ull ^ vkey[value]);
+                    cnext[j] += mix64(rkey[i] * 0x9e3779b97f4a7c15ull ^ vkey[value]);
+                    vnext[value] += mix64(rkey[i] * 0x9e3779b97f4a7c15ull ^ ckey[j] * 0xc2b2ae3d27d4eb4full);
+                }
+            }
+        }
+        for(int k = 0; k < sidelength; k++) {
+            rkey[k] = mix64(rkey[k] + rnext[k]);
+            ckey[k] = mix64(ckey[k] + cnext[k]);
+            vkey[k + 1] = mix64(vkey[k + 1] + vnext[k + 1]);
+        }
+    }
+}
+
+/**
+ * @brief Sorts items by key with an insertion sort that keeps equal keys in their order.
+ */
+static void sort_by_key(int *items, int n, const uint64_t *key) {
+    for(int k = 1; k < n; k++) {
+        int item = items[k];
+        int p = k;
+        while(p > 0 && key[items[p - 1]] > key[item]) {
+            items[p] = items[p - 1];
+            p--;
+        }
+        items[p] = item;
+    }
+}
+
+/**
+ * @brief Orders the lines (rows or columns) of a grid by band and by key inside each band.
+ *
+ * @param key The keys of the lines.
+ * @param base The base, lines k * base to k * base + base - 1 form band k.
+ * @param lines Output, the line at every position.
+ */
+static void order_lines(const uint64_t *key, int base, unsigned char *lines) {
+    uint64_t band_key[MAX_BASE] = {0};
+    int bands[MAX_BASE];
+    for(int b = 0; b < base; b++) {
+        for(int k = 0; k < base; k++) {
+            band_key[b] += mix64(key[b * base + k]);
+        }
+        bands[b] = b;
+    }
+    sort_by_key(bands, base, band_key);
+    for(int p = 0; p < base; p++) {
+        int inner[MAX_BASE];
+        for(int k = 0; k < base; k++) {
+            inner[k] = bands[p] * base + k;
+        }
+        sort_by_key(inner, base, key);
+        for(int k = 0; k < base; k++) {
+            lines[p * base + k] = inner[k];
+        }
+    }
+}
+
+/**
+ * @brief Builds the candidate canonical form of one orientation of a grid.
+ */
+static void orient(unsigned char (*grid)[MAX_SIDELENGTH], int base, bool transpose, canon_t *canon, unsigned char (*out)[MAX_SIDELENGTH]) {
+    int sidelength = base * base;
+    unsigned char oriented[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            oriented[i][j] = transpose ? grid[j][i] : grid[i][j];
+        }
+    }
+    uint64_t rkey[MAX_SIDELENGTH];
+    uint64_t ckey[MAX_SIDELENGTH];
+    refine(oriented, sidelength, rkey, ckey);
+    canon->base = base;
+    canon->transpose = transpose;
+    order_lines(rkey, base, canon->rows);
+    order_lines(ckey, base, canon->cols);
+
+    // Values are numbered in the order they first appear, the missing ones after them
+    memset(canon->relabel, 0, sizeof(canon->relabel));
+    int next = 1;
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            int value = oriented[canon->rows[i]][canon->cols[j]];
+            if(value != 0 && canon->relabel[value] == 0) {
+                canon->relabel[value] = next++;
+            }
+            out[i][j] = canon->relabel[value];
+        }
+    }
+    for(int value = 1; value <= sidelength; value++) {
+        if(canon->relabel[value] == 0) {
+            canon->relabel[value] = next++;
+        }
+    }
+}
+
+/**
+ * @brief Returns a hash of the cells of a grid.
+ */
+static uint64_t grid_hash(unsigned char (*grid)[MAX_SIDELENGTH], int base) {
+    int sidelength = base * base;
+    uint64_t hash = mix64(base);
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            hash = (hash ^ grid[i][j]) * 0x100000001b3ull;
+        }
+    }
+    return mix64(hash);
+}
+
+/**
+ * @brief Builds the canonical form of a grid, see the comment at the top.
+ *
+ * @param grid The cells, 0 for an empty cell.
+ * @param base The base of the grid.
+ * @param canon Output, the symmetry that maps the grid to its form.
+ * @param out Output, the cells of the form.
+ *
+ * @return The hash of the form.
+ */
+uint64_t canon_form(unsigned char (*grid)[MAX_SIDELENGTH], int base, canon_t *canon, unsigned char (*out)[MAX_SIDELENGTH]) {
+    int sidelength = base * base;
+    canon_t other;
+    unsigned char other_out[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    orient(grid, base, false, canon, out);
+    orient(grid, base, true, &other, other_out);
+    for(int i = 0; i < sidelength; i++) {
+        int order = memcmp(other_out[i], out[i], sidelength);
+        if(order < 0) {
+            *canon = other;
+            for(int k = 0; k < sidelength; k++) {
+                memcpy(out[k], other_out[k], sidelength);
+            }
+        }
+        if(order != 0) {
+            break;
+        }
+    }
+    return grid_hash(out, base);
+}
+
+/**
+ * @brief Maps a grid in canonical form, typically the solution of a form, back to the grid it came from.
+ *
+ * @param canon The symmetry canon_form() returned for the grid.
+ * @param canonical The cells in canonical form.
+ * @param out Output, the cells in the layout and the labels of the original grid.
+ */
+void canon_restore(const canon_t *canon, unsigned char (*canonical)[MAX_SIDELENGTH], unsigned char (*out)[MAX_SIDELENGTH]) {
+    int sidelength = canon->base * canon->base;
+    unsigned char label[MAX_SIDELENGTH + 1] = {0};
+    for(int value = 1; value <= sidelength; value++) {
+        label[canon->relabel[value]] = value;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            int row = canon->rows[i];
+            int column = canon->cols[j];
+            unsigned char value = label[canonical[i][j]];
+            if(canon->transpose) {
+                out[column][row] = value;
+            } else {
+                out[row][column] = value;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Allocates an empty cache of capacity slots.
+ *
+ * @return 1 on success, 0 if the slots cannot be allocated.
+ */
+int cache_init(cache_t *cache, long capacity) {
+    cache->entries = calloc(capacity, sizeof(cache_entry_t));
+    cache->capacity = capacity;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->stored = 0;
+    if(cache->entries == NULL) {
+        printf("Error allocating cache\n");
+        return 0;
+    }
+    return 1;
+}
+
+void cache_free(cache_t *cache) {
+    for(long k = 0; k < cache->capacity; k++) {
+        free(cache->entries[k].puzzle);
+        free(cache->entries[k].solution);
+    }
+    free(cache->entries);
+    cache->entries = NULL;
+}
+
+/**
+ * @brief Looks a canonical puzzle up and counts the hit or the miss.
+ *
+ * @param cache The cache.
+ * @param hash The hash canon_form() returned for the puzzle.
+ * @param base The base of the puzzle.
+ * @param puzzle The cells of the canonical form.
+ * @param solution Output, the canonical solution on a hit of a solvable puzzle.
+ *
+ * @return 1 on a hit with a solution, 0 on a hit of an unsolvable puzzle, -1 on a miss.
+ */
+int cache_lookup(cache_t *cache, uint64_t hash, int base, unsigned char (*puzzle)[MAX_SIDELENGTH], unsigned char (*solution)[MAX_SIDELENGTH]) {
+    cache_entry_t *entry = &cache->entries[hash % cache->capacity];
+    int sidelength = base * base;
+    bool hit = entry->base == base && entry->hash == hash;
+    for(int i = 0; hit && i < sidelength; i++) {
+        hit = memcmp(entry->puzzle + i * sidelength, puzzle[i], sidelength) == 0;
+    }
+    if(!hit) {
+        cache->misses++;
+        return -1;
+    }
+    cache->hits++;
+    if(!entry->solvable) {
+        return 0;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(solution[i], entry->solution + i * sidelength, sidelength);
+    }
+    return 1;
+}
+
+/**
+ * @brief Stores the result of a canonical puzzle in its slot, replacing what was there.
+ *
+ * @param solution The canonical solution, NULL if the puzzle has none.
+ */
+void cache_store(cache_t *cache, uint64_t hash, int base, unsigned char (*puzzle)[MAX_SIDELENGTH], unsigned char (*solution)[MAX_SIDELENGTH]) {
+    cache_entry_t *entry = &cache->entries[hash % cache->capacity];
+    int sidelength = base * base;
+    if(entry->base != base) {
+        // Slots are sized to the board of the puzzle they hold
+        free(entry->puzzle);
+        free(entry->solution);
+        cache->stored -= entry->base != 0;
+        entry->base = 0;
+        entry->puzzle = malloc(sidelength * sidelength);
+        entry->solution = malloc(sidelength * sidelength);
+        if(entry->puzzle == NULL || entry->solution == NULL) {
+            free(entry->puzzle);
+            free(entry->solution);
+            entry->puzzle = NULL;
+            entry->solution = NULL;
+            return;
+        }
+        cache->stored++;
+    }
+    entry->base = base;
+    entry->hash = hash;
+    entry->solvable = solution != NULL;
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(entry->puzzle + i * sidelength, puzzle[i], sidelength);
+        if(solution != NULL) {
+            memcpy(entry->solution + i * sidelength, solution[i], sidelength);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+// How a grid maps to its canonical form: canonical cell (i, j) holds relabel[value] of cell
+// (rows[i], cols[j]) of the oriented grid, which is the grid transposed when transpose is set
+typedef struct {
+    int base;
+    bool transpose;
+    unsigned char rows[MAX_SIDELENGTH];
+    unsigned char cols[MAX_SIDELENGTH];
+    unsigned char relabel[MAX_SIDELENGTH + 1];
+} canon_t;
+
+// One solved canonical puzzle, puzzle and solution packed row-major
+typedef struct {
+    uint64_t hash;
+    int base;                   // 0 for an empty entry
+    bool solvable;
+    unsigned char *puzzle;
+    unsigned char *solution;
+} cache_entry_t;
+
+// Direct-mapped cache of results by canonical form, a new puzzle replaces the one in its slot
+typedef struct {
+    cache_entry_t *entries;
+    long capacity;
+    long hits;
+    long misses;
+    long stored;                // Slots holding a result
+} cache_t;
+
+uint64_t canon_form(unsigned char (*grid)[MAX_SIDELENGTH], int base, canon_t *canon, unsigned char (*out)[MAX_SIDELENGTH]);
+
+void canon_restore(const canon_t *canon, unsigned char (*canonical)[MAX_SIDELENGTH], unsigned char (*out)[MAX_SIDELENGTH]);
+
+int cache_init(cache_t *cache, long capacity);
+
+void cache_free(cache_t *cache);
+
+int cache_lookup(cache_t *cache, uint64_t hash, int base, unsigned char (*puzzle)[MAX_SIDELENGTH], unsigned char (*solution)[MAX_SIDELENGTH]);
+
+void cache_store(cache_t *cache, uint64_t hash, int base, unsigned char (*puzzle)[MAX_SIDELENGTH], unsigned char (*solution)[MAX_SIDELENGTH]);
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "solver.h"
+#include "checkpoint.h"
+
+// Longest path accepted from a file
+#define MAX_CELLS 4096
+
+/*
+ * Checkpoint files of the work-stealing search.
+ *
+ * A checkpoint holds the open subtrees of a search: every work item in the pool and, split
+ * the same way donate() splits a frame, everything still open on the stacks of the threads.
+ * An item is the assignment trail leading to it from the root board, the cell it branches on
+ * and the mask of the values of that cell left to try. Cells filled by propagation are not
+ * stored, replaying the trail fills them again. Nothing depends on the thread that held an
+ * item, so a search resumes from its checkpoint on any number of threads.
+ *
+ * Layout, integers in the byte order of the machine:
+ *   CHECKPOINT_MAGIC, base and side length as bytes, the side length^2 cells of the root
+ *   board, the solutions counted so far and the number of items as 64 bit integers, then
+ *   per item: the cell as two bytes, the remaining values as a 64 bit integer, the number of
+ *   decisions as a 16 bit integer and per decision the cell and the value as three bytes.
+ *
+ * The file is written next to its final path and renamed over it once complete, so a
+ * process killed while writing leaves the previous checkpoint intact.
+ */
+
+/**
+ * @brief Writes one item of the frontier.
+ *
+ * @return 1 on success, 0 on a write error.
+ */
+static int write_item(FILE *out, const work_t *item) {
+    unsigned char cell[2] = {item->cell.x, item->cell.y};
+    uint16_t depth = item->depth;
+    if(fwrite(cell, 1, 2, out) != 2 || fwrite(&item->remaining, sizeof(uint64_t), 1, out) != 1
+       || fwrite(&depth, sizeof(uint16_t), 1, out) != 1) {
+        return 0;
+    }
+    for(int k = 0; k < item->depth; k++) {
+        unsigned char decision[3] = {item->path[k].cell.x, item->path[k].cell.y, item->path[k].value};
+        if(fwrite(decision, 1, 3, out) != 3) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes the open subtrees of a search to a checkpoint file.
+ *
+ * @param path The checkpoint, replaced once the new one is complete.
+ * @param root The board the paths of the items start from.
+ * @param lists Lists of items, linked by next.
+ * @param nlists The number of lists.
+ * @param solutions Counting: the solutions found so far.
+ *
+ * @return 1 on success, 0 if the file cannot be written.
+ */
+int checkpoint_write(const char *path, const board_t *root, work_t *const *lists, int nlists, long solutions) {
+    size_t length = strlen(path);
+    char *partial = malloc(length + 5);
+    if(partial == NULL) {
+        return 0;
+    }
+    memcpy(partial, path, length);
+    memcpy(partial + length, ".tmp", 5);
+    FILE *out = fopen(partial, "wb");
+    if(out == NULL) {
+        printf("Could not open %s\n", partial);
+        free(partial);
+        return 0;
+    }
+    int64_t count = 0;
+    for(int n = 0; n < nlists; n++) {
+        for(const work_t *item = lists[n]; item != NULL; item = item->next) {
+            count++;
+        }
+    }
+    int64_t found = solutions;
+    unsigned char header[2] = {root->base, root->sidelength};
+    int status = fwrite(CHECKPOINT_MAGIC, 1, CHECKPOINT_MAGIC_LEN, out) == CHECKPOINT_MAGIC_LEN
+              && fwrite(header, 1, 2, out) == 2;
+    for(int i = 0; status && i < root->sidelength; i++) {
+        status = fwrite(root->board[i], 1, root->sidelength, out) == root->sidelength;
+    }
+    status = status && fwrite(&found, sizeof(int64_t), 1, out) == 1 && fwrite(&count, sizeof(int64_t), 1, out) == 1;
+    for(int n = 0; status && n < nlists; n++) {
+        for(const work_t *item = lists[n]; status && item != NULL; item = item->next) {
+            status = write_item(out, item);
+        }
+    }
+    status = fflush(out) == 0 && status;
+    status = status && fsync(fileno(out)) == 0;
+    status = fclose(out) == 0 && status;
+    status = status && rename(partial, path) == 0;
+    if(!status) {
+        printf("Error writing checkpoint %s\n", path);
+        remove(partial);
+    }
+    free(partial);
+    return status;
+}
+
+/**
+ * @brief Reads one item of the frontier and checks that it fits the root board.
+ *
+ * @return The item, or NULL if the file ends early or the item does not fit.
+ */
+static work_t *read_item(FILE *in, const board_t *root) {
+    unsigned char cell[2];
+    uint64_t remaining;
+    uint16_t depth;
+    if(fread(cell, 1, 2, in) != 2 || fread(&remaining, sizeof(uint64_t), 1, in) != 1
+       || fread(&depth, sizeof(uint16_t), 1, in) != 1) {
+        return NULL;
+    }
+    int sidelength = root->sidelength;
+    if(cell[0] >= sidelength || cell[1] >= sidelength || root->board[cell[0]][cell[1]] != 0 || depth >= root->n_zeros
+       || depth >= MAX_CELLS || (sidelength < 64 && remaining >> sidelength != 0)) {
+        return NULL;
+    }
+    work_t *item = malloc(sizeof(work_t) + sizeof(decision_t) * depth);
+    if(item == NULL) {
+        return NULL;
+    }
+    item->next = NULL;
+    item->cell.x = cell[0];
+    item->cell.y = cell[1];
+    item->remaining = remaining;
+    item->depth = depth;
+    for(int k = 0; k < depth; k++) {
+        unsigned char decision[3];
+        if(fread(decision, 1, 3, in) != 3 || decision[0] >= sidelength || decision[1] >= sidelength
+           || root->board[decision[0]][decision[1]] != 0 || decision[2] < 1 || decision[2] > sidelength) {
+            free(item);
+            return NULL;
+        }
+        item->path[k].cell.x = decision[0];
+        item->path[k].cell.y = decision[1];
+        item->path[k].value = decision[2];
+    }
+    return item;
+}
+
+/**
+ * @brief Reads the open subtrees of a search back from a checkpoint file.
+ *
+ * The root board has to be the one the checkpoint was written for, loaded and propagated
+ * the same way. The items keep the order they were written in.
+ *
+ * @param path The checkpoint.
+ * @param root The board the search resumes on.
+ * @param frontier Output, the items and the solutions counted before the checkpoint.
+ *
+ * @return 1 on success, 0 if the file cannot be read or was written for another board.
+ */
+int checkpoint_read(const char *path, const board_t *root, frontier_t *frontier) {
+    frontier->items = NULL;
+    frontier->count = 0;
+    frontier->solutions = 0;
+    FILE *in = fopen(path, "rb");
+    if(in == NULL) {
+        printf("Could not open %s\n", path);
+        return 0;
+    }
+    char magic[CHECKPOINT_MAGIC_LEN];
+    unsigned char header[2];
+    unsigned char row[MAX_SIDELENGTH];
+    int64_t found;
+    int64_t count;
+    int status = fread(magic, 1, CHECKPOINT_MAGIC_LEN, in) == CHECKPOINT_MAGIC_LEN
+              && memcmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN) == 0
+              && fread(header, 1, 2, in) == 2;
+    if(!status) {
+        printf("Not a checkpoint: %s\n", path);
+        fclose(in);
+        return 0;
+    }
+    status = header[0] == root->base && header[1] == root->sidelength;
+    for(int i = 0; status && i < root->sidelength; i++) {
+        status = fread(row, 1, root->sidelength, in) == root->sidelength && memcmp(row, root->board[i], root->sidelength) == 0;
+    }
+    if(!status) {
+        printf("Checkpoint %s was written for another board\n", path);
+        fclose(in);
+        return 0;
+    }
+    status = fread(&found, sizeof(int64_t), 1, in) == 1 && fread(&count, sizeof(int64_t), 1, in) == 1 && count >= 0;
+    work_t **tail = &frontier->items;
+    for(int64_t k = 0; status && k < count; k++) {
+        work_t *item = read_item(in, root);
+        status = item != NULL;
+        if(status) {
+            *tail = item;
+            tail = &item->next;
+            frontier->count++;
+        }
+    }
+    fclose(in);
+    if(!status) {
+        printf("Checkpoint %s is damaged\n", path);
+        frontier_free(frontier);
+        return 0;
+    }
+    frontier->solutions = found;
+    return 1;
+}
+
+/**
+ * @brief Frees the items left in a frontier.
+ */
+void frontier_free(frontier_t *frontier) {
+    while(frontier->items != NULL) {
+        work_t *next = frontier->items->next;
+        free(frontier->items);
+        frontier->items = next;
+    }
+    frontier->count = 0;
+}
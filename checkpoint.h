@@ -0,0 +1,30 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+// First bytes of a checkpoint, followed by the root board and the open subtrees, see checkpoint.c
+#define CHECKPOINT_MAGIC "SUDOKUK1"
+#define CHECKPOINT_MAGIC_LEN 8
+
+// A subtree: the decisions leading to it from the root board, and the values left to try in cell
+typedef struct work_s {
+    struct work_s *next;
+    ua_t cell;
+    uint64_t remaining;
+    int depth;
+    decision_t path[];
+} work_t;
+
+// The open subtrees of a search read back from a checkpoint
+typedef struct frontier_s {
+    work_t *items;
+    long count;
+    long solutions;         // Counting: solutions found before the checkpoint was written
+} frontier_t;
+
+int checkpoint_write(const char *path, const board_t *root, work_t *const *lists, int nlists, long solutions);
+
+int checkpoint_read(const char *path, const board_t *root, frontier_t *frontier);
+
+void frontier_free(frontier_t *frontier);
@@ -0,0 +1,871 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "loader.h"
+#include "verify.h"
+#include "stats.h"
+#include "checkpoint.h"
+#include "distrib.h"
+
+#define MAX_CELLS 4096
+
+// Workers one coordinator serves at the same time
+#define MAX_PEERS 256
+
+// Largest message payload: a subproblem with a decision for every cell
+#define MAX_PAYLOAD (2 + 3 * MAX_CELLS)
+
+// Connections waiting to be accepted by the coordinator
+#define DISTRIB_BACKLOG 16
+
+/*
+ * Search distributed over worker processes.
+ *
+ * The coordinator splits the board into subproblems by expanding the first levels of the
+ * search breadth first, until there are DISTRIB_PIECES_PER_WORKER of them per local worker.
+ * A subproblem is a partial assignment: the values placed on the root board on the way down,
+ * without the cells propagation filled. The coordinator never searches itself, it hands the
+ * subproblems out one at a time to the workers that ask for one.
+ *
+ * A worker gets the root board when it connects, then asks for a subproblem, rebuilds its
+ * board from the root and the assignment, propagates it like a loaded board and runs the
+ * threaded engine on it with the options of its own command line, and asks for the next one
+ * with the solutions and nodes of the last. While it searches, a listener thread waits for
+ * the coordinator: a stop message sets the found flag of the search, which ends it on the
+ * next node of every thread.
+ *
+ * The first solution a worker reports ends the search: the coordinator verifies and prints
+ * it and sends every worker a stop. When counting, the counts of the subproblems are added
+ * up and the search ends once every subproblem is done or the limit is reached. A worker that
+ * goes away in the middle of a subproblem has it put back in the queue.
+ *
+ * Local workers are forked and talk to the coordinator over socket pairs; with a port the
+ * coordinator also accepts workers over TCP, started on any machine with the worker mode.
+ * Messages are a type and a length as 32 bit integers followed by the payload, integers in
+ * the byte order of the machine, so every worker has to share the coordinator's.
+ */
+
+typedef enum {
+    MSG_HELLO = 1,      // Coordinator: base, side length, counting flag, limit and the cells of the root board
+    MSG_REQUEST,        // Worker: solutions and nodes of the subproblem it finished, and a request for the next
+    MSG_WORK,           // Coordinator: a subproblem, the number of decisions and the cell and value of each
+    MSG_STOP,           // Coordinator: no work is left, or a solution ended the search
+    MSG_SOLUTION        // Worker: the cells of a solution
+} message_type_t;
+
+// A subproblem: values placed on the root board, the search of the rest is the worker's
+typedef struct {
+    int depth;
+    decision_t path[];
+} piece_t;
+
+// Buffers of a board rebuilt from the root cells and the decisions of a subproblem
+typedef struct {
+    board_t board;
+    ua_t ua[MAX_CELLS];
+    unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
+    int64_t bits[4 * MAX_SIDELENGTH];
+} piece_board_t;
+
+typedef struct {
+    int fd;
+    pid_t pid;          // Local worker process, 0 for a remote worker
+    long piece;         // Subproblem being searched, -1 for none
+    bool waiting;       // Asked for a subproblem while the queue was empty
+} peer_t;
+
+typedef struct {
+    board_t *root;
+    unsigned char grid[MAX_SIDELENGTH][MAX_SIDELENGTH];    // Cells of the root board
+    piece_t **pieces;   // Every subproblem, NULL once it is done
+    long n_pieces;
+    long *queue;        // Subproblems not handed out, as a ring of indices into pieces
+    long head;
+    long queued;
+    long assigned;      // Subproblems a worker is searching
+    long handed;        // Subproblems handed out, a subproblem put back counts again
+    peer_t peers[MAX_PEERS];
+    int n_peers;
+    int listener;       // TCP socket remote workers connect to, -1 for none
+    long solutions;
+    long nodes;
+    bool stopping;      // A solution or the limit ended the search
+} coordinator_t;
+
+// State the listener thread of a worker shares with the search it watches
+typedef struct {
+    int fd;
+    int wake;           // Read end of the pipe the worker writes to once the search is over
+    search_t *search;
+    bool stopped;       // The coordinator sent a stop or went away
+} listener_t;
+
+/**
+ * @brief Writes all of a buffer to a descriptor.
+ *
+ * @return 1 on success, 0 if the descriptor was closed or failed.
+ */
+static int write_all(int fd, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    while(length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return 0;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return 1;
+}
+
+/**
+ * @brief Fills a buffer from a descriptor.
+ *
+ * @return 1 on success, 0 if the descriptor was closed or failed first.
+ */
+static int read_all(int fd, void *data, size_t length) {
+    unsigned char *bytes = data;
+    while(length > 0) {
+        ssize_t n = read(fd, bytes, length);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return 0;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return 1;
+}
+
+static int send_message(int fd, uint32_t type, const void *payload, uint32_t length) {
+    uint32_t header[2] = {type, length};
+    return write_all(fd, header, sizeof(header)) && (length == 0 || write_all(fd, payload, length));
+}
+
+/**
+ * @brief Reads one message into a buffer of MAX_PAYLOAD bytes.
+ *
+ * @return 1 on success, 0 if the connection ended or the message is too long.
+ */
+static int recv_message(int fd, uint32_t *type, unsigned char *payload, uint32_t *length) {
+    uint32_t header[2];
+    if(!read_all(fd, header, sizeof(header)) || header[1] > MAX_PAYLOAD) {
+        return 0;
+    }
+    *type = header[0];
+    *length = header[1];
+    return header[1] == 0 || read_all(fd, payload, header[1]);
+}
+
+/**
+ * @brief Builds the board of a subproblem: the root cells with its decisions placed, propagated like a loaded board.
+ *
+ * @return The number of empty cells left, -1 if propagation finds the subproblem has no solution.
+ */
+static short int piece_build(piece_board_t *pb, unsigned char (*root)[MAX_SIDELENGTH], int base, const solver_opts_t *opts,
+                             search_t *search, const decision_t *path, int depth) {
+    int sidelength = base * base;
+    pb->board.board = pb->board_array;
+    pb->board.rbits = pb->bits;
+    pb->board.cbits = pb->bits + MAX_SIDELENGTH;
+    pb->board.bbits = pb->bits + 2 * MAX_SIDELENGTH;
+    pb->board.filled = tracks_filled(opts) ? pb->bits + 3 * MAX_SIDELENGTH : NULL;
+    pb->board.count = opts->order != ORDER_FIXED ? pb->count_array : NULL;
+    pb->board.tally = pb->board.count != NULL ? pb->tally_array : NULL;
+    pb->board.tally_rows = pb->board.count != NULL ? pb->tally_rows : NULL;
+    pb->board.opts = opts;
+    pb->board.search = search;
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(pb->board_array[i], root[i], sidelength);
+    }
+    for(int k = 0; k < depth; k++) {
+        pb->board_array[path[k].cell.x][path[k].cell.y] = path[k].value;
+    }
+    if(!board_finish(&pb->board, pb->ua, base)) {
+        return -1;
+    }
+    return load_propagate(&pb->board, pb->ua);
+}
+
+/**
+ * @brief Takes a solution found by a worker, or by the split, given as packed rows.
+ *
+ * A grid that changes a given of the root board or breaks a rule is refused, anyone can
+ * connect over TCP. The first one is copied to the root board; it is printed and ends the
+ * search unless the search counts, in which case it is only kept like count_solution() keeps it.
+ *
+ * @return 1 if the solution was taken or another one already was, 0 if it was refused.
+ */
+static int take_solution(coordinator_t *co, const unsigned char *cells) {
+    board_t *root = co->root;
+    search_t *search = root->search;
+    int sidelength = root->sidelength;
+    if(root->opts->count ? atomic_load(&search->published) : search_done(search)) {
+        return 1;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            if(co->grid[i][j] != 0 && cells[i * sidelength + j] != co->grid[i][j]) {
+                fprintf(stderr, "Refused a solution that changes the given at row %d, column %d\n", i, j);
+                return 0;
+            }
+        }
+        memcpy(root->board[i], cells + i * sidelength, sidelength);
+    }
+    if(!verify(root)) {
+        fprintf(stderr, "Refused an invalid solution\n");
+        for(int i = 0; i < sidelength; i++) {
+            memcpy(root->board[i], co->grid[i], sidelength);
+        }
+        return 0;
+    }
+    if(root->opts->count) {
+        atomic_store(&search->published, true);
+        memcpy(search->solution, root->board, grid_bytes(sidelength));
+        search->valid = true;
+        return 1;
+    }
+    // Claims the found flag and prints the board like a solution of a local search
+    report_solution(root);
+    co->stopping = true;
+    return 1;
+}
+
+static void enqueue(coordinator_t *co, long piece) {
+    co->queue[(co->head + co->queued) % co->n_pieces] = piece;
+    co->queued++;
+}
+
+static long dequeue(coordinator_t *co) {
+    long piece = co->queue[co->head];
+    co->head = (co->head + 1) % co->n_pieces;
+    co->queued--;
+    return piece;
+}
+
+/**
+ * @brief Appends a subproblem to the list of the split, growing it as needed.
+ *
+ * @return 1 on success, 0 if memory runs out.
+ */
+static int append_piece(coordinator_t *co, piece_t *piece, long *capacity) {
+    if(co->n_pieces == *capacity) {
+        long grown = 2 * *capacity;
+        piece_t **pieces = realloc(co->pieces, sizeof(piece_t *) * grown);
+        if(pieces != NULL) {
+            co->pieces = pieces;
+        }
+        long *queue = realloc(co->queue, sizeof(long) * grown);
+        if(queue != NULL) {
+            co->queue = queue;
+        }
+        if(pieces == NULL || queue == NULL) {
+            return 0;
+        }
+        *capacity = grown;
+    }
+    co->pieces[co->n_pieces] = piece;
+    co->queue[co->head + co->queued] = co->n_pieces;
+    co->n_pieces++;
+    co->queued++;
+    return 1;
+}
+
+/**
+ * @brief Splits the root board into subproblems, expanding the shallowest one until there are target of them.
+ *
+ * Subproblems that propagation refutes are dropped, complete ones are solutions and taken
+ * right away.
+ *
+ * @return 1 on success, 0 if memory runs out.
+ */
+static int split(coordinator_t *co, long target) {
+    board_t *root = co->root;
+    search_t search;
+    search_init(&search, true);
+    long capacity = 2 * target;
+    piece_board_t *pb = malloc(sizeof(piece_board_t));
+    co->pieces = malloc(sizeof(piece_t *) * capacity);
+    co->queue = malloc(sizeof(long) * capacity);
+    piece_t *first = malloc(sizeof(piece_t));
+    int status = pb != NULL && co->pieces != NULL && co->queue != NULL && first != NULL;
+    if(status) {
+        first->depth = 0;
+        status = append_piece(co, first, &capacity);
+    } else {
+        free(first);
+    }
+    // The list is only a ring once the split is over, until then it grows at the back
+    while(status && co->queued > 0 && co->queued < target && !co->stopping) {
+        long index = co->queue[co->head++];
+        co->queued--;
+        piece_t *piece = co->pieces[index];
+        co->pieces[index] = NULL;
+        short int zeroes = piece_build(pb, co->grid, root->base, root->opts, &search, piece->path, piece->depth);
+        ua_t cell;
+        if(zeroes == 0) {
+            unsigned char cells[MAX_CELLS];
+            for(int i = 0; i < root->sidelength; i++) {
+                memcpy(cells + i * root->sidelength, pb->board_array[i], root->sidelength);
+            }
+            co->solutions++;
+            take_solution(co, cells);
+            if(root->opts->count && root->opts->limit > 0 && co->solutions >= root->opts->limit) {
+                co->stopping = true;
+            }
+        } else if(zeroes > 0 && select_cell(pb->ua, &pb->board, zeroes, &cell)) {
+            uint64_t remaining = candidates(&pb->board, cell.x, cell.y);
+            while(status && remaining != 0) {
+                int value = __builtin_ctzll(remaining) + 1;
+                remaining &= remaining - 1;
+                piece_t *child = malloc(sizeof(piece_t) + sizeof(decision_t) * (piece->depth + 1));
+                status = child != NULL;
+                if(status) {
+                    child->depth = piece->depth + 1;
+                    memcpy(child->path, piece->path, sizeof(decision_t) * piece->depth);
+                    child->path[piece->depth].cell = cell;
+                    child->path[piece->depth].value = value;
+                    status = append_piece(co, child, &capacity);
+                    if(!status) {
+                        free(child);
+                    }
+                }
+            }
+        }
+        free(piece);
+    }
+    free(pb);
+    if(!status) {
+        printf("Error allocating subproblems\n");
+        return 0;
+    }
+    // Only the subproblems still queued are left, renumber them from 0 for the ring
+    for(long k = 0; k < co->queued; k++) {
+        co->pieces[k] = co->pieces[co->queue[co->head + k]];
+        co->queue[k] = k;
+    }
+    co->n_pieces = co->queued;
+    co->head = 0;
+    return 1;
+}
+
+/**
+ * @brief Sends a worker the next subproblem, or marks it waiting if there is none.
+ *
+ * @return 1 on success, 0 if the worker went away.
+ */
+static int hand_out(coordinator_t *co, peer_t *peer) {
+    if(co->queued == 0) {
+        peer->waiting = true;
+        return 1;
+    }
+    long index = dequeue(co);
+    piece_t *piece = co->pieces[index];
+    unsigned char payload[MAX_PAYLOAD];
+    uint16_t depth = piece->depth;
+    memcpy(payload, &depth, sizeof(uint16_t));
+    for(int k = 0; k < piece->depth; k++) {
+        payload[2 + 3 * k] = piece->path[k].cell.x;
+        payload[3 + 3 * k] = piece->path[k].cell.y;
+        payload[4 + 3 * k] = piece->path[k].value;
+    }
+    peer->waiting = false;
+    if(!send_message(peer->fd, MSG_WORK, payload, 2 + 3 * piece->depth)) {
+        enqueue(co, index);
+        return 0;
+    }
+    peer->piece = index;
+    co->assigned++;
+    co->handed++;
+    return 1;
+}
+
+/**
+ * @brief Sends the root board to a new worker and adds it to the peers.
+ *
+ * @return 1 on success, 0 if the peer table is full or the worker went away.
+ */
+static int add_peer(coordinator_t *co, int fd, pid_t pid) {
+    board_t *root = co->root;
+    int sidelength = root->sidelength;
+    unsigned char payload[MAX_PAYLOAD];
+    int64_t limit = root->opts->limit;
+    payload[0] = root->base;
+    payload[1] = sidelength;
+    payload[2] = root->opts->count;
+    memcpy(payload + 3, &limit, sizeof(int64_t));
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(payload + 3 + sizeof(int64_t) + i * sidelength, co->grid[i], sidelength);
+    }
+    if(co->n_peers == MAX_PEERS || !send_message(fd, MSG_HELLO, payload, 3 + sizeof(int64_t) + sidelength * sidelength)) {
+        close(fd);
+        return 0;
+    }
+    peer_t *peer = &co->peers[co->n_peers++];
+    peer->fd = fd;
+    peer->pid = pid;
+    peer->piece = -1;
+    peer->waiting = false;
+    return 1;
+}
+
+/**
+ * @brief Closes the connection of a worker, putting its subproblem back in the queue.
+ */
+static void drop_peer(coordinator_t *co, int k) {
+    peer_t *peer = &co->peers[k];
+    if(peer->piece >= 0) {
+        enqueue(co, peer->piece);
+        co->assigned--;
+    }
+    close(peer->fd);
+    co->peers[k] = co->peers[--co->n_peers];
+}
+
+/**
+ * @brief Handles one message of a worker.
+ *
+ * @return 1 on success, 0 if the worker went away or broke the protocol.
+ */
+static int serve_peer(coordinator_t *co, peer_t *peer) {
+    unsigned char payload[MAX_PAYLOAD];
+    uint32_t type;
+    uint32_t length;
+    if(!recv_message(peer->fd, &type, payload, &length)) {
+        return 0;
+    }
+    board_t *root = co->root;
+    int sidelength = root->sidelength;
+    if(type == MSG_SOLUTION && length == (uint32_t)(sidelength * sidelength)) {
+        // A worker that sends a wrong solution is dropped, its subproblem goes to another one
+        return take_solution(co, payload);
+    }
+    if(type != MSG_REQUEST || length != 2 * sizeof(int64_t)) {
+        return 0;
+    }
+    int64_t report[2];
+    memcpy(report, payload, sizeof(report));
+    co->solutions += report[0];
+    co->nodes += report[1];
+    if(peer->piece >= 0) {
+        free(co->pieces[peer->piece]);
+        co->pieces[peer->piece] = NULL;
+        peer->piece = -1;
+        co->assigned--;
+    }
+    if(root->opts->count && root->opts->limit > 0 && co->solutions >= root->opts->limit) {
+        co->stopping = true;
+    }
+    return co->stopping || hand_out(co, peer);
+}
+
+/**
+ * @brief Opens the TCP socket remote workers connect to.
+ *
+ * @return The socket, -1 if it cannot be opened.
+ */
+static int open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) {
+        printf("Could not create socket\n");
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, DISTRIB_BACKLOG) != 0) {
+        printf("Could not listen on port %d\n", port);
+        close(fd);
+        return -1;
+    }
+    fprintf(stderr, "Listening for workers on port %d\n", port);
+    return fd;
+}
+
+static int worker_loop(int fd, const solver_opts_t *opts, int nthreads, int cutoff, long *pieces, long *nodes);
+
+/**
+ * @brief Forks a local worker connected to the coordinator by a socket pair.
+ *
+ * @return 1 on success, 0 if the process or the socket pair cannot be created.
+ */
+static int fork_worker(coordinator_t *co, int nthreads, int cutoff) {
+    int pair[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        printf("Could not create socket pair\n");
+        return 0;
+    }
+    // Buffered output would be written twice
+    fflush(NULL);
+    pid_t pid = fork();
+    if(pid < 0) {
+        printf("Could not fork worker\n");
+        close(pair[0]);
+        close(pair[1]);
+        return 0;
+    }
+    if(pid == 0) {
+        close(pair[0]);
+        for(int k = 0; k < co->n_peers; k++) {
+            close(co->peers[k].fd);
+        }
+        if(co->listener >= 0) {
+            close(co->listener);
+        }
+        long pieces;
+        long nodes;
+        _exit(worker_loop(pair[1], co->root->opts, nthreads, cutoff, &pieces, &nodes) ? 0 : 1);
+    }
+    close(pair[1]);
+    return add_peer(co, pair[0], pid);
+}
+
+/**
+ * @brief Solves a board over worker processes, see the comment at the top.
+ *
+ * Has to be called before the process starts any OpenMP thread team, the forked workers start
+ * their own. The solution or the count ends up on the board and its search like run_engine()
+ * leaves them.
+ *
+ * @param board The loaded and propagated board.
+ * @param ua The array of unassigned cells of the board.
+ * @param zeroes The number of empty cells left.
+ * @param local The number of worker processes to fork.
+ * @param port TCP port to accept remote workers on, 0 for none.
+ * @param nthreads The threads of every local worker.
+ * @param cutoff The task cutoff of the local workers, only used by the cutoff scheduler.
+ *
+ * @return 1 if the search ran to its end, 0 if it could not be set up or every worker went away with work left.
+ */
+int distrib_coordinate(board_t *board, ua_t *ua, short int zeroes, int local, int port, int nthreads, int cutoff) {
+    (void)ua;
+    (void)zeroes;
+    coordinator_t *co = calloc(1, sizeof(coordinator_t));
+    if(co == NULL) {
+        printf("Error allocating coordinator\n");
+        return 0;
+    }
+    co->root = board;
+    co->listener = -1;
+    for(int i = 0; i < board->sidelength; i++) {
+        memcpy(co->grid[i], board->board[i], board->sidelength);
+    }
+    // A worker that goes away must not take the coordinator with it
+    signal(SIGPIPE, SIG_IGN);
+    long target = (long)DISTRIB_PIECES_PER_WORKER * (local > 0 ? local : 1);
+    int status = split(co, target);
+    if(status && !co->stopping && co->queued > 0) {
+        if(port > 0) {
+            co->listener = open_listener(port);
+            status = co->listener >= 0;
+        }
+        for(int k = 0; status && k < local; k++) {
+            status = fork_worker(co, nthreads, cutoff);
+        }
+    }
+    long initial = co->queued;
+    while(status && !co->stopping && (co->queued > 0 || co->assigned > 0)) {
+        if(co->n_peers == 0 && co->listener < 0) {
+            printf("Every worker went away with %ld subproblems left\n", co->queued + co->assigned);
+            status = 0;
+            break;
+        }
+        struct pollfd fds[MAX_PEERS + 1];
+        int n = 0;
+        for(int k = 0; k < co->n_peers; k++) {
+            fds[n++] = (struct pollfd){ .fd = co->peers[k].fd, .events = POLLIN };
+        }
+        if(co->listener >= 0) {
+            fds[n++] = (struct pollfd){ .fd = co->listener, .events = POLLIN };
+        }
+        if(poll(fds, n, -1) < 0) {
+            continue;
+        }
+        // Backwards, dropping a peer moves the last one into its slot
+        for(int k = co->n_peers - 1; k >= 0; k--) {
+            if(fds[k].revents != 0 && !serve_peer(co, &co->peers[k])) {
+                drop_peer(co, k);
+            }
+        }
+        if(co->listener >= 0 && fds[n - 1].revents != 0) {
+            int client = accept(co->listener, NULL, NULL);
+            if(client >= 0) {
+                int yes = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                add_peer(co, client, 0);
+            }
+        }
+        // Subproblems put back by workers that went away go to the ones waiting
+        for(int k = co->n_peers - 1; k >= 0 && co->queued > 0; k--) {
+            if(co->peers[k].waiting && !hand_out(co, &co->peers[k])) {
+                drop_peer(co, k);
+            }
+        }
+    }
+    // Workers still searching stop on their next node, waiting ones leave
+    for(int k = co->n_peers - 1; k >= 0; k--) {
+        send_message(co->peers[k].fd, MSG_STOP, NULL, 0);
+        pid_t pid = co->peers[k].pid;
+        drop_peer(co, k);
+        if(pid > 0) {
+            waitpid(pid, NULL, 0);
+        }
+    }
+    while(waitpid(-1, NULL, WNOHANG) > 0) {
+    }
+    if(co->listener >= 0) {
+        close(co->listener);
+    }
+    atomic_store(&board->search->solutions, co->solutions);
+    if(board->opts->limit > 0 && co->solutions >= board->opts->limit) {
+        atomic_store(&board->search->found, true);
+    }
+    fprintf(stderr, "Distributed: %ld subproblems, %ld handed out, %ld nodes\n", initial, co->handed, co->nodes);
+    for(long k = 0; k < co->n_pieces && co->pieces != NULL; k++) {
+        free(co->pieces[k]);
+    }
+    free(co->pieces);
+    free(co->queue);
+    free(co);
+    return status;
+}
+
+/**
+ * @brief Waits for a stop from the coordinator while a worker searches, see listener_t.
+ */
+static void *listen_stop(void *arg) {
+    listener_t *listener = arg;
+    struct pollfd fds[2] = { { .fd = listener->fd, .events = POLLIN }, { .fd = listener->wake, .events = POLLIN } };
+    while(poll(fds, 2, -1) < 0 && errno == EINTR) {
+    }
+    if(fds[1].revents != 0) {
+        char byte;
+        if(read(listener->wake, &byte, 1) < 0) {
+            return NULL;
+        }
+        // The search is over, a stop that raced with the wake up is read by the worker loop
+        return NULL;
+    }
+    unsigned char payload[MAX_PAYLOAD];
+    uint32_t type;
+    uint32_t length;
+    // Anything but a stop while searching breaks the protocol, and a closed connection means the coordinator is gone
+    recv_message(listener->fd, &type, payload, &length);
+    listener->stopped = true;
+    atomic_store(&listener->search->found, true);
+    return NULL;
+}
+
+/**
+ * @brief Serves a coordinator on a connection until it sends a stop, see the comment at the top.
+ *
+ * @param pieces Output, the subproblems searched.
+ * @param nodes Output, the nodes searched.
+ *
+ * @return 1 once the coordinator sent a stop, 0 if the connection failed first.
+ */
+static int worker_loop(int fd, const solver_opts_t *opts, int nthreads, int cutoff, long *pieces, long *nodes) {
+    unsigned char payload[MAX_PAYLOAD];
+    uint32_t type;
+    uint32_t length;
+    *pieces = 0;
+    *nodes = 0;
+    if(!recv_message(fd, &type, payload, &length) || type != MSG_HELLO || length < 3 + sizeof(int64_t)) {
+        printf("No board from the coordinator\n");
+        return 0;
+    }
+    int base = payload[0];
+    int sidelength = payload[1];
+    if(base < 1 || base > 8 || sidelength != base * base || length != 3 + sizeof(int64_t) + sidelength * sidelength) {
+        printf("Invalid board from the coordinator\n");
+        return 0;
+    }
+    solver_opts_t piece_opts = *opts;
+    piece_opts.count = payload[2];
+    int64_t limit;
+    memcpy(&limit, payload + 3, sizeof(int64_t));
+    piece_opts.limit = limit;
+    piece_opts.checkpoint = NULL;
+    piece_opts.resume = NULL;
+    unsigned char root[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(root[i], payload + 3 + sizeof(int64_t) + i * sidelength, sidelength);
+    }
+
+    piece_board_t *pb = malloc(sizeof(piece_board_t));
+    decision_t *path = malloc(sizeof(decision_t) * MAX_CELLS);
+    int wake[2];
+    if(pb == NULL || path == NULL || pipe(wake) != 0) {
+        printf("Error allocating worker\n");
+        free(pb);
+        free(path);
+        return 0;
+    }
+    // The search counters are threadprivate and are read back by a team of the same size
+    omp_set_dynamic(0);
+    search_t search;
+    int64_t report[2] = {0, 0};
+    bool sent_solution = false;
+    int status = 0;
+    while(send_message(fd, MSG_REQUEST, report, sizeof(report)) && recv_message(fd, &type, payload, &length)) {
+        uint16_t depth;
+        if(type == MSG_STOP) {
+            status = 1;
+            break;
+        }
+        memcpy(&depth, payload, sizeof(uint16_t));
+        if(type != MSG_WORK || length != 2 + 3u * depth || depth > MAX_CELLS) {
+            printf("Invalid message from the coordinator\n");
+            break;
+        }
+        bool fits = true;
+        for(int k = 0; k < depth && fits; k++) {
+            path[k].cell.x = payload[2 + 3 * k];
+            path[k].cell.y = payload[3 + 3 * k];
+            path[k].value = payload[4 + 3 * k];
+            fits = path[k].cell.x < sidelength && path[k].cell.y < sidelength && root[path[k].cell.x][path[k].cell.y] == 0
+                && path[k].value >= 1 && path[k].value <= sidelength;
+        }
+        if(!fits) {
+            printf("Invalid subproblem from the coordinator\n");
+            break;
+        }
+        (*pieces)++;
+        report[0] = 0;
+        report[1] = 0;
+        search_init(&search, true);
+        short int zeroes = piece_build(pb, root, base, &piece_opts, &search, path, depth);
+        if(zeroes < 0) {
+            continue;
+        }
+        listener_t listener = { .fd = fd, .wake = wake[0], .search = &search, .stopped = false };
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, listen_stop, &listener) != 0) {
+            printf("Could not start the listener\n");
+            break;
+        }
+        stats_reset(nthreads);
+        #pragma omp parallel num_threads(nthreads)
+        {
+            #pragma omp single nowait
+            {
+                run_engine(pb->ua, &pb->board, zeroes, cutoff);
+            }
+        }
+        char byte = 0;
+        if(write(wake[1], &byte, 1) != 1) {
+            listener.stopped = true;
+        }
+        pthread_join(thread, NULL);
+        if(listener.stopped) {
+            status = 1;
+            break;
+        }
+        report[1] = stats_nodes(nthreads);
+        *nodes += report[1];
+        bool found = piece_opts.count ? atomic_load(&search.published) : search_done(&search);
+        report[0] = piece_opts.count ? atomic_load(&search.solutions) : found;
+        if(found && !sent_solution) {
+            unsigned char cells[MAX_CELLS];
+            for(int i = 0; i < sidelength; i++) {
+                memcpy(cells + i * sidelength, pb->board_array[i], sidelength);
+            }
+            if(!send_message(fd, MSG_SOLUTION, cells, sidelength * sidelength)) {
+                break;
+            }
+            // When counting, the first solution is the one the coordinator keeps and verifies
+            sent_solution = piece_opts.count;
+        }
+    }
+    close(wake[0]);
+    close(wake[1]);
+    free(pb);
+    free(path);
+    return status;
+}
+
+/**
+ * @brief Connects to a coordinator at host:port and searches its subproblems until it sends a stop.
+ *
+ * @param address The coordinator, host:port.
+ * @param opts The options of the searches, counting is set by the coordinator.
+ * @param nthreads The threads of every search.
+ * @param cutoff The task cutoff, only used by the cutoff scheduler.
+ *
+ * @return 1 once the coordinator stopped the worker, 0 if it cannot be reached or the connection failed.
+ */
+int distrib_work(const char *address, const solver_opts_t *opts, int nthreads, int cutoff) {
+    const char *colon = strrchr(address, ':');
+    if(colon == NULL || colon == address) {
+        printf("Invalid coordinator address: %s\n", address);
+        return 0;
+    }
+    char host[256];
+    size_t length = colon - address;
+    if(length >= sizeof(host)) {
+        printf("Invalid coordinator address: %s\n", address);
+        return 0;
+    }
+    memcpy(host, address, length);
+    host[length] = '\0';
+    struct addrinfo hints;
+    struct addrinfo *found;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, colon + 1, &hints, &found) != 0) {
+        printf("Unknown coordinator: %s\n", address);
+        return 0;
+    }
+    int fd = -1;
+    for(struct addrinfo *ai = found; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if(fd < 0) {
+        printf("Could not connect to %s\n", address);
+        return 0;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    signal(SIGPIPE, SIG_IGN);
+    double time = omp_get_wtime();
+    long pieces;
+    long nodes;
+    int status = worker_loop(fd, opts, nthreads, cutoff, &pieces, &nodes);
+    close(fd);
+    fprintf(stderr, "Worker: %ld subproblems, %ld nodes, Nthreads: %d time taken: %f seconds\n", pieces, nodes, nthreads,
+            omp_get_wtime() - time);
+    return status;
+}
@@ -0,0 +1,11 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+// Subproblems the coordinator splits the board into per local worker
+#define DISTRIB_PIECES_PER_WORKER 32
+
+int distrib_coordinate(board_t *board, ua_t *ua, short int zeroes, int local, int port, int nthreads, int cutoff);
+
+int distrib_work(const char *address, const solver_opts_t *opts, int nthreads, int cutoff);
@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "propagate.h"
+#include "dlx.h"
+#include "stats.h"
+
+// Constraint families, each one has sidelength * sidelength columns
+#define CELL_CONSTRAINT 0
+#define ROW_CONSTRAINT 1
+#define COLUMN_CONSTRAINT 2
+#define BLOCK_CONSTRAINT 3
+
+/*
+ * Node of the Dancing Links matrix. Links are indices into one node array instead of pointers,
+ * so a matrix can be copied for a task with a single memcpy. Node 0 is the root and nodes
+ * 1..n_cols are the column headers.
+ */
+typedef struct {
+    int left;
+    int right;
+    int up;
+    int down;
+    int col;                // Column header of the node
+    unsigned char row;      // Candidate of the node, a value placed at (row, column)
+    unsigned char column;
+    unsigned char value;
+} dlx_node_t;
+
+typedef struct {
+    dlx_node_t *nodes;
+    int *size;              // Number of rows in each column, indexed by header node
+    int n_nodes;
+    int n_cols;
+} dlx_t;
+
+/**
+ * @brief Links a new node at the bottom of column col.
+ */
+static inline void append_to_column(dlx_t *dlx, int node, int col) {
+    dlx_node_t *n = dlx->nodes;
+    n[node].col = col;
+    n[node].down = col;
+    n[node].up = n[col].up;
+    n[n[col].up].down = node;
+    n[col].up = node;
+    dlx->size[col]++;
+}
+
+/**
+ * @brief Builds the exact cover matrix for the empty cells of the board.
+ *
+ * The full model has sidelength^3 candidate rows and 4 * sidelength^2 constraint columns
+ * (one value per cell, and every value once per row, column and block). Constraints already
+ * satisfied by the filled cells are left out, and so are the candidates they rule out, so
+ * the matrix only holds the residual problem.
+ *
+ * @param dlx The matrix to build, the node and size arrays are allocated here.
+ * @param ua The array of unassigned cells built by board_init().
+ * @param board Pointer to the Sudoku board structure.
+ *
+ * @return 1 on success, 0 if the allocation failed.
+ */
+static int dlx_build(dlx_t *dlx, ua_t *ua, board_t *board) {
+    int sidelength = board->sidelength;
+    int cells = sidelength * sidelength;
+    int n_rows = 0;
+    int *header = malloc(sizeof(int) * 4 * cells);
+    if(header == NULL) {
+        return 0;
+    }
+    for(int i = 0; i < 4 * cells; i++) {
+        header[i] = -1;
+    }
+
+    // Number the open constraints: every empty cell, and every value still missing from a unit
+    int n_cols = 0;
+    for(int k = 0; k < board->n_zeros; k++) {
+        int row = ua[k].x;
+        int column = ua[k].y;
+        if(board->board[row][column] != 0) {
+            continue;
+        }
+        header[CELL_CONSTRAINT * cells + row * sidelength + column] = ++n_cols;
+        n_rows += __builtin_popcountll(candidates(board, row, column));
+    }
+    int64_t *bits[4] = {NULL, board->rbits, board->cbits, board->bbits};
+    for(int f = ROW_CONSTRAINT; f <= BLOCK_CONSTRAINT; f++) {
+        for(int i = 0; i < sidelength; i++) {
+            for(uint64_t missing = ~(uint64_t)bits[f][i] & full_mask(sidelength); missing; missing &= missing - 1) {
+                header[f * cells + i * sidelength + __builtin_ctzll(missing)] = ++n_cols;
+            }
+        }
+    }
+
+    dlx->n_cols = n_cols;
+    dlx->n_nodes = 1 + n_cols + 4 * n_rows;
+    dlx->nodes = malloc(sizeof(dlx_node_t) * dlx->n_nodes);
+    dlx->size = calloc(n_cols + 1, sizeof(int));
+    if(dlx->nodes == NULL || dlx->size == NULL) {
+        free(dlx->nodes);
+        free(dlx->size);
+        free(header);
+        return 0;
+    }
+    dlx_node_t *n = dlx->nodes;
+    for(int h = 0; h <= n_cols; h++) {
+        n[h].left = h == 0 ? n_cols : h - 1;
+        n[h].right = h == n_cols ? 0 : h + 1;
+        n[h].up = h;
+        n[h].down = h;
+        n[h].col = h;
+    }
+
+    // One row of four nodes per candidate of every empty cell
+    int next = n_cols + 1;
+    for(int k = 0; k < board->n_zeros; k++) {
+        int row = ua[k].x;
+        int column = ua[k].y;
+        if(board->board[row][column] != 0) {
+            continue;
+        }
+        int block = block_index(board, row, column);
+        for(uint64_t cand = candidates(board, row, column); cand; cand &= cand - 1) {
+            int v = __builtin_ctzll(cand);
+            int id[4] = {
+                CELL_CONSTRAINT * cells + row * sidelength + column,
+                ROW_CONSTRAINT * cells + row * sidelength + v,
+                COLUMN_CONSTRAINT * cells + column * sidelength + v,
+                BLOCK_CONSTRAINT * cells + block * sidelength + v
+            };
+            for(int f = 0; f < 4; f++) {
+                int node = next + f;
+                n[node].left = next + (f + 3) % 4;
+                n[node].right = next + (f + 1) % 4;
+                n[node].row = row;
+                n[node].column = column;
+                n[node].value = v + 1;
+                append_to_column(dlx, node, header[id[f]]);
+            }
+            next += 4;
+        }
+    }
+    free(header);
+    return 1;
+}
+
+/**
+ * @brief Removes column col from the header list and every row of col from the other columns.
+ */
+static inline void cover(dlx_t *dlx, int col) {
+    dlx_node_t *n = dlx->nodes;
+    n[n[col].right].left = n[col].left;
+    n[n[col].left].right = n[col].right;
+    for(int i = n[col].down; i != col; i = n[i].down) {
+        for(int j = n[i].right; j != i; j = n[j].right) {
+            n[n[j].down].up = n[j].up;
+            n[n[j].up].down = n[j].down;
+            dlx->size[n[j].col]--;
+        }
+    }
+}
+
+/**
+ * @brief Reverts cover(), the links have to be restored in the exact reverse order.
+ */
+static inline void uncover(dlx_t *dlx, int col) {
+    dlx_node_t *n = dlx->nodes;
+    for(int i = n[col].up; i != col; i = n[i].up) {
+        for(int j = n[i].left; j != i; j = n[j].left) {
+            dlx->size[n[j].col]++;
+            n[n[j].down].up = j;
+            n[n[j].up].down = j;
+        }
+    }
+    n[n[col].right].left = col;
+    n[n[col].left].right = col;
+}
+
+/**
+ * @brief Returns the open column with the fewest rows, or 0 if every column is covered.
+ */
+static inline int choose_column(dlx_t *dlx) {
+    dlx_node_t *n = dlx->nodes;
+    int best = 0;
+    int best_size = __INT_MAX__;
+    for(int col = n[0].right; col != 0; col = n[col].right) {
+        if(dlx->size[col] < best_size) {
+            best = col;
+            best_size = dlx->size[col];
+            if(best_size <= 1) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Selects a row by covering the columns of all its other nodes.
+ */
+static inline void select_row(dlx_t *dlx, int node) {
+    for(int j = dlx->nodes[node].right; j != node; j = dlx->nodes[j].right) {
+        cover(dlx, dlx->nodes[j].col);
+    }
+}
+
+/**
+ * @brief Reverts select_row().
+ */
+static inline void unselect_row(dlx_t *dlx, int node) {
+    for(int j = dlx->nodes[node].left; j != node; j = dlx->nodes[j].left) {
+        uncover(dlx, dlx->nodes[j].col);
+    }
+}
+
+/**
+ * @brief Algorithm X over the matrix, always branching on the column with the fewest rows.
+ *
+ * The selected rows are written to the board directly since each search owns its board, and
+ * a complete cover is a filled board that is handed to report_solution().
+ *
+ * @param dlx The matrix, restored to its original state when the call returns false.
+ * @param board The board of the search, the selected candidates are placed on it.
+ * @param depth The number of rows selected since the matrix was built.
+ * @return true if this search published the solution, or reached the limit when counting.
+ */
+static bool dlx_search(dlx_t *dlx, board_t *board, int depth) {
+    if(search_done(board->search)) {
+        return false;
+    }
+    stats_node(depth);
+    int col = choose_column(dlx);
+    if(col == 0) {
+        return report_solution(board);
+    }
+    if(dlx->size[col] == 0) {
+        return false;
+    }
+    cover(dlx, col);
+    for(int r = dlx->nodes[col].down; r != col; r = dlx->nodes[r].down) {
+        dlx_node_t *node = &dlx->nodes[r];
+        board->board[node->row][node->column] = node->value;
+        select_row(dlx, r);
+        if(dlx_search(dlx, board, depth + 1)) {
+            return true;
+        }
+        unselect_row(dlx, r);
+        board->board[node->row][node->column] = 0;
+        stats_backtrack();
+    }
+    uncover(dlx, col);
+    return false;
+}
+
+/**
+ * @brief Solves the board as an exact cover problem with Dancing Links.
+ *
+ * The matrix is built once from the board and the unassigned cells. Every row of the
+ * first branching column becomes an OpenMP task that searches its own copy of the matrix
+ * and of the board, so this has to be called from inside a parallel region like solver().
+ * Only the cells are written by the search, the bitmasks of the board are left untouched.
+ *
+ * @param ua The array of unassigned cells built by board_init().
+ * @param board A pointer to the Sudoku board structure.
+ * @param zeroes The number of empty cells left.
+ * @return true if a solution is found, false otherwise.
+ */
+bool dlx_solver(ua_t *ua, board_t *board, short int zeroes) {
+    if(zeroes == 0) {
+        report_solution(board);
+        return true;
+    }
+    dlx_t dlx;
+    if(!dlx_build(&dlx, ua, board)) {
+        printf("Error allocating the exact cover matrix\n");
+        return false;
+    }
+    int col = choose_column(&dlx);
+    cover(&dlx, col);
+    for(int r = dlx.nodes[col].down; r != col; r = dlx.nodes[r].down) {
+        stats_task_spawned();
+        #pragma omp task firstprivate(r) shared(dlx)
+        {
+            stats_task_executed();
+            dlx_t task_dlx = dlx;
+            task_dlx.nodes = NULL;
+            task_dlx.size = NULL;
+            unsigned char (*task_board_array)[MAX_SIDELENGTH] = NULL;
+            // A task that starts after the search was won skips copying the matrix
+            if(!search_done(board->search)) {
+                task_dlx.nodes = malloc(sizeof(dlx_node_t) * dlx.n_nodes);
+                task_dlx.size = malloc(sizeof(int) * (dlx.n_cols + 1));
+                task_board_array = malloc(sizeof(unsigned char) * MAX_SIDELENGTH * board->sidelength);
+                if(task_dlx.nodes == NULL || task_dlx.size == NULL || task_board_array == NULL) {
+                    printf("Error allocating the exact cover matrix\n");
+                } else {
+                    double copy_start = stats_copy_begin();
+                    memcpy(task_dlx.nodes, dlx.nodes, sizeof(dlx_node_t) * dlx.n_nodes);
+                    memcpy(task_dlx.size, dlx.size, sizeof(int) * (dlx.n_cols + 1));
+                    memcpy(task_board_array, board->board, grid_bytes(board->sidelength));
+                    stats_copy_end(copy_start);
+                    // The search writes its cells into its own grid, none of them go on the trail
+                    board_t task_board = *board;
+                    task_board.board = task_board_array;
+                    task_board.trail_base = trail_mark();
+
+                    dlx_node_t *node = &task_dlx.nodes[r];
+                    task_board.board[node->row][node->column] = node->value;
+                    select_row(&task_dlx, r);
+                    stats_search_begin();
+                    dlx_search(&task_dlx, &task_board, 1);
+                    stats_search_end();
+                }
+            }
+            free(task_dlx.nodes);
+            free(task_dlx.size);
+            free(task_board_array);
+            solutions_flush();
+        }
+    }
+    #pragma omp taskwait
+    free(dlx.nodes);
+    free(dlx.size);
+    return search_done(board->search);
+}
@@ -0,0 +1,6 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+bool dlx_solver(ua_t *ua, board_t *board, short int zeroes);
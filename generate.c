@@ -0,0 +1,547 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <omp.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "solver.h"
+#include "board.h"
+#include "loader.h"
+#include "stats.h"
+
+#define MAX_CELLS 4096
+
+// Largest base whose values fit the 64 bit masks
+#define MAX_BASE 8
+
+// Puzzles graded hard need at least one search node per this many cells
+#define HARD_CELLS_PER_NODE 2
+
+// Puzzles graded easy are solved on load in at most this many propagation passes per unit of side length
+#define EASY_PASSES_PER_SIDE 2
+
+// Default search nodes a uniqueness check may take per cell
+#define CHECK_NODES_PER_CELL 2
+
+// Search nodes per cell the first search for a full grid may take, see random_grid()
+#define GRID_NODES_PER_CELL 4
+
+/*
+ * Puzzle generator, linked against solver.c built without its main like the benchmark.
+ *
+ * A full grid is the first solution the solver finds for the empty board with its values
+ * and its MRV ties drawn from the random numbers of the puzzle, see random_grid(), so the
+ * grids are spread over every symmetry class instead of being scrambles of one pattern.
+ *
+ * Holes are then dug in a random cell order, keeping a hole only if the puzzle still has a
+ * unique solution, counted with the solver itself (-u). Proving uniqueness can take an
+ * exhaustive search that grows quickly with the holes of large boards, so every check has a
+ * node budget (-b), and a check ends in one of three ways: unique, at least 2 solutions, or
+ * out of budget. The search is sequential, so which one only depends on the puzzle.
+ *
+ * Digging one cell at a time goes through the order in passes. A unique cell is dug, a cell
+ * with 2 solutions stays a given for good and a cell that ran out is deferred. When a pass
+ * dug a hole the deferred cells are tested again in the next one, against the puzzle with
+ * the new holes, otherwise they stay givens.
+ *
+ * The digging in parallel gives the same puzzle whatever the width and the thread count. The
+ * next width cells of the pass are tested at the same time, one task each, against the
+ * current puzzle. The cells before the first unique one saw the puzzle the cell by cell
+ * digging sees, so their results stand. The first unique one is dug. Of the later cells only
+ * those with 2 solutions are decided: more holes only add solutions, so no order of digging
+ * could clear them. The others are tested again in the next round.
+ *
+ * Every puzzle is graded by the depth of the propagation on load, the naked and hidden singles
+ * passes it takes, and the nodes of a first solution search with MRV and propagation: easy if
+ * the propagation solves it in at most EASY_PASSES_PER_SIDE passes per unit of side length,
+ * hard if the search took at least a node per HARD_CELLS_PER_NODE cells, medium otherwise.
+ * The budget of the checks scales with the cells as well, a hard puzzle has holes whose
+ * uniqueness proof needs real search and the budget has to leave room for them.
+ */
+
+// Outcome of a uniqueness check
+typedef enum {
+    CHECK_UNIQUE,
+    CHECK_NOT_UNIQUE,   // At least 2 solutions, or none, final
+    CHECK_EXHAUSTED     // Ran out of budget before either
+} check_t;
+
+// State of a cell of the digging order
+typedef enum {
+    CELL_OPEN,          // To be tested in the current pass
+    CELL_DEFERRED,      // Ran out of budget, tested again in the next pass
+    CELL_DONE           // Dug, or a given for good
+} cell_state_t;
+
+typedef enum {
+    GRADE_EASY,
+    GRADE_MEDIUM,
+    GRADE_HARD
+} grade_t;
+
+static const char *grade_names[] = {"easy", "medium", "hard"};
+
+typedef struct {
+    long attempt;           // Seeds the random numbers of the puzzle
+    int base;
+    unsigned char grid[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    int givens;
+    int propagated;         // Cells filled by propagation on load
+    long passes;            // Naked and hidden singles passes of that propagation
+    bool failed;            // A workspace could not be allocated, the puzzle is not written
+    long nodes;             // Nodes of the first solution search
+    grade_t grade;
+} puzzle_t;
+
+// Buffers of one board and its search
+typedef struct {
+    board_t board;
+    search_t search;
+    ua_t ua[MAX_CELLS];
+    unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
+    int64_t bits[4 * MAX_SIDELENGTH];
+} workspace_t;
+
+/**
+ * @brief Returns the next number of a splitmix64 sequence.
+ */
+static inline uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Fills values with a random permutation of 0..n-1.
+ */
+static void shuffle(int *values, int n, uint64_t *state) {
+    for(int k = 0; k < n; k++) {
+        values[k] = k;
+    }
+    for(int k = n - 1; k > 0; k--) {
+        int other = next_random(state) % (k + 1);
+        int swap = values[k];
+        values[k] = values[other];
+        values[other] = swap;
+    }
+}
+
+/**
+ * @brief Loads the cells of a puzzle into a workspace, with one cell left out.
+ *
+ * @param ws The workspace.
+ * @param puzzle The puzzle.
+ * @param hole The cell to clear, or an index outside the board to clear none.
+ * @param opts The solver options of the search.
+ *
+ * @return The number of empty cells left after propagation, -1 if the puzzle has no solution.
+ */
+static short int workspace_load(workspace_t *ws, const puzzle_t *puzzle, int hole, const solver_opts_t *opts) {
+    int sidelength = puzzle->base * puzzle->base;
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(ws->board_array[i], puzzle->grid[i], sidelength);
+    }
+    if(hole >= 0 && hole < sidelength * sidelength) {
+        ws->board_array[hole / sidelength][hole % sidelength] = 0;
+    }
+    ws->board.board = ws->board_array;
+    ws->board.rbits = ws->bits;
+    ws->board.cbits = ws->bits + MAX_SIDELENGTH;
+    ws->board.bbits = ws->bits + 2 * MAX_SIDELENGTH;
+    ws->board.filled = tracks_filled(opts) ? ws->bits + 3 * MAX_SIDELENGTH : NULL;
+    ws->board.count = opts->order != ORDER_FIXED ? ws->count_array : NULL;
+    ws->board.tally = ws->board.count != NULL ? ws->tally_array : NULL;
+    ws->board.tally_rows = ws->board.count != NULL ? ws->tally_rows : NULL;
+    ws->board.opts = opts;
+    ws->board.search = &ws->search;
+    search_init(&ws->search, true);
+    board_finish(&ws->board, ws->ua, puzzle->base);
+    return load_propagate(&ws->board, ws->ua);
+}
+
+/**
+ * @brief Checks whether the puzzle with one more hole still has a unique solution.
+ *
+ * The check runs on the calling thread, the parallelism is across the checks.
+ *
+ * @param puzzle The puzzle.
+ * @param hole The cell to clear.
+ * @param budget The nodes the search may take.
+ */
+static check_t unique_without(const puzzle_t *puzzle, int hole, long budget) {
+    static const solver_opts_t opts = { .engine = ENGINE_BITMASK, .scheduler = SCHED_CUTOFF, .order = ORDER_MRV,
+                                        .propagate = true, .count = true, .limit = 2 };
+    workspace_t *ws = malloc(sizeof(workspace_t));
+    if(ws == NULL) {
+        printf("Error allocating workspace\n");
+        return CHECK_EXHAUSTED;
+    }
+    short int zeroes = workspace_load(ws, puzzle, hole, &opts);
+    check_t check = CHECK_NOT_UNIQUE;
+    if(zeroes >= 0) {
+        // A cutoff of 0 keeps the whole search sequential
+        ws->search.stop_nodes = stats_thread()->nodes + budget;
+        run_engine(ws->ua, &ws->board, zeroes, 0);
+        long solutions = atomic_load(&ws->search.solutions);
+        if(solutions == 1 && !atomic_load(&ws->search.exhausted)) {
+            check = CHECK_UNIQUE;
+        } else if(solutions < 2 && atomic_load(&ws->search.exhausted)) {
+            check = CHECK_EXHAUSTED;
+        }
+    }
+    free(ws);
+    return check;
+}
+
+/**
+ * @brief Fills the grid of a puzzle with a random full grid of its base.
+ *
+ * The grid is the first solution the solver finds for the empty board with its values and
+ * its MRV ties in a random order. That search has a heavy tail on large boards, so it gets
+ * a budget of GRID_NODES_PER_CELL nodes per cell, and a search that runs out starts over
+ * with the next seed and twice the budget.
+ *
+ * @return 1 on success, 0 if the workspace could not be allocated.
+ */
+static int random_grid(puzzle_t *puzzle, uint64_t *state) {
+    int sidelength = puzzle->base * puzzle->base;
+    workspace_t *ws = malloc(sizeof(workspace_t));
+    if(ws == NULL) {
+        printf("Error allocating workspace\n");
+        return 0;
+    }
+    long budget = (long)GRID_NODES_PER_CELL * sidelength * sidelength;
+    bool filled = false;
+    while(!filled) {
+        solver_opts_t opts = { .engine = ENGINE_BITMASK, .scheduler = SCHED_CUTOFF, .order = ORDER_MRV,
+                               .values = VALUES_RANDOM, .seed = next_random(state) | 1, .propagate = true };
+        memset(puzzle->grid, 0, sizeof(puzzle->grid));
+        short int zeroes = workspace_load(ws, puzzle, -1, &opts);
+        ws->search.stop_nodes = stats_thread()->nodes + budget;
+        run_engine(ws->ua, &ws->board, zeroes, 0);
+        filled = atomic_load(&ws->search.published);
+        budget *= 2;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(puzzle->grid[i], ws->board_array[i], sidelength);
+    }
+    free(ws);
+    return 1;
+}
+
+/**
+ * @brief Digs holes in the full grid of a puzzle as long as its solution stays unique.
+ *
+ * @param puzzle The puzzle, holding a full grid.
+ * @param width The cells tested at the same time.
+ * @param max_holes Holes to stop at, digging also stops when no cell can be cleared any more.
+ * @param budget The nodes a uniqueness check may take.
+ * @param state The random numbers of the puzzle.
+ */
+static void dig(puzzle_t *puzzle, int width, int max_holes, long budget, uint64_t *state) {
+    int sidelength = puzzle->base * puzzle->base;
+    int n_cells = sidelength * sidelength;
+    int *order = malloc(sizeof(int) * n_cells);
+    cell_state_t *cell = calloc(n_cells, sizeof(cell_state_t));
+    int *round = malloc(sizeof(int) * width);
+    check_t *check = malloc(sizeof(check_t) * width);
+    if(order == NULL || cell == NULL || round == NULL || check == NULL) {
+        printf("Error allocating the digging order\n");
+    } else {
+        shuffle(order, n_cells, state);
+        int pos = 0;
+        int holes = 0;
+        bool dug_in_pass = false;
+        bool deferred = false;
+        while(holes < max_holes) {
+            if(pos == n_cells) {
+                // The deferred cells get another pass only if this one changed the puzzle
+                if(!dug_in_pass || !deferred) {
+                    break;
+                }
+                for(int k = 0; k < n_cells; k++) {
+                    if(cell[k] == CELL_DEFERRED) {
+                        cell[k] = CELL_OPEN;
+                    }
+                }
+                pos = 0;
+                dug_in_pass = false;
+                deferred = false;
+            }
+            int n_round = 0;
+            for(int k = pos; k < n_cells && n_round < width; k++) {
+                if(cell[k] == CELL_OPEN) {
+                    round[n_round++] = k;
+                }
+            }
+            for(int r = 0; r < n_round; r++) {
+                #pragma omp task firstprivate(r)
+                check[r] = unique_without(puzzle, order[round[r]], budget);
+            }
+            #pragma omp taskwait
+
+            bool dug = false;
+            for(int r = 0; r < n_round; r++) {
+                int k = round[r];
+                // After the first hole of the round only the final results stand
+                if(check[r] == CHECK_NOT_UNIQUE) {
+                    // More holes only add solutions, so the cell stays a given
+                    cell[k] = CELL_DONE;
+                } else if(dug) {
+                    continue;
+                } else if(check[r] == CHECK_EXHAUSTED) {
+                    cell[k] = CELL_DEFERRED;
+                    deferred = true;
+                } else {
+                    puzzle->grid[order[k] / sidelength][order[k] % sidelength] = 0;
+                    cell[k] = CELL_DONE;
+                    dug = true;
+                    dug_in_pass = true;
+                    holes++;
+                }
+            }
+            while(pos < n_cells && cell[pos] != CELL_OPEN) {
+                pos++;
+            }
+        }
+    }
+    free(order);
+    free(cell);
+    free(round);
+    free(check);
+}
+
+/**
+ * @brief Grades a puzzle by the cells propagation fills on load and the nodes a search needs.
+ *
+ * The search runs sequentially on the calling thread, so its nodes are the difference of
+ * the thread's node counter.
+ */
+static void grade(puzzle_t *puzzle) {
+    static const solver_opts_t opts = { .engine = ENGINE_BITMASK, .scheduler = SCHED_CUTOFF, .order = ORDER_MRV,
+                                        .propagate = true };
+    workspace_t *ws = malloc(sizeof(workspace_t));
+    if(ws == NULL) {
+        printf("Error allocating workspace\n");
+        return;
+    }
+    long passes = stats_thread()->passes;
+    short int zeroes = workspace_load(ws, puzzle, -1, &opts);
+    puzzle->passes = stats_thread()->passes - passes;
+    int sidelength = puzzle->base * puzzle->base;
+    puzzle->givens = sidelength * sidelength - ws->board.n_zeros;
+    puzzle->propagated = ws->board.n_zeros - zeroes;
+    long nodes = stats_thread()->nodes;
+    run_engine(ws->ua, &ws->board, zeroes, 0);
+    puzzle->nodes = stats_thread()->nodes - nodes;
+    if(zeroes == 0 && puzzle->passes <= (long)EASY_PASSES_PER_SIDE * sidelength) {
+        puzzle->grade = GRADE_EASY;
+    } else if(puzzle->nodes >= (long)sidelength * sidelength / HARD_CELLS_PER_NODE) {
+        puzzle->grade = GRADE_HARD;
+    } else {
+        puzzle->grade = GRADE_MEDIUM;
+    }
+    free(ws);
+}
+
+/**
+ * @brief Generates, digs and grades one puzzle, the body of a task.
+ */
+static void generate_puzzle(puzzle_t *puzzle, uint64_t seed, int width, int max_holes, long budget) {
+    uint64_t state = seed ^ (0x9e3779b97f4a7c15ull * (puzzle->attempt + 1));
+    puzzle->failed = !random_grid(puzzle, &state);
+    if(puzzle->failed) {
+        return;
+    }
+    dig(puzzle, width, max_holes, budget, &state);
+    grade(puzzle);
+}
+
+/**
+ * @brief Writes a puzzle in the .dat layout.
+ *
+ * @return 1 on success, 0 on a write error.
+ */
+static int write_puzzle(FILE *out, const puzzle_t *puzzle) {
+    unsigned char sidelength = puzzle->base * puzzle->base;
+    unsigned char header[2] = {puzzle->base, sidelength};
+    if(fwrite(header, 1, 2, out) != 2) {
+        return 0;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        if(fwrite(puzzle->grid[i], 1, sidelength, out) != sidelength) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void usage(const char *name) {
+    printf("Usage: %s [-s size] [-n count] [-t threads] [-w width] [-h holes] [-b nodes] [-g easy|medium|hard] [-a attempts] [-r seed] <file|->\n", name);
+    printf("Writes count uniquely solvable puzzles as back to back .dat boards, one graded line per puzzle on stderr.\n");
+    printf("-s: side length, the square of a base from 2 to 8, e.g. 9, 16, 25, 36 or 64 (default 36)\n");
+    printf("-n: puzzles to write (default 1)\n");
+    printf("-t: threads (default 1)\n");
+    printf("-w: cells of a puzzle tested at the same time while digging (default the thread count)\n");
+    printf("-h: stop digging a puzzle at this many holes (default dig until every given is needed)\n");
+    printf("-b: search nodes a uniqueness check may take before the hole is deferred to the next pass (default %d per cell)\n", CHECK_NODES_PER_CELL);
+    printf("-g: lowest grade kept, puzzles below it are dropped (default easy)\n");
+    printf("-a: puzzles to try at most (default 100 times the count with -g medium or hard, the count otherwise)\n");
+    printf("-r: random seed (default 1), the puzzles only depend on it and not on -t or -w\n");
+}
+
+int main(int argc, char *argv[]) {
+    int sidelength = 36;
+    long count = 1;
+    int nthreads = 1;
+    int width = 0;
+    int max_holes = 0;
+    long budget = 0;
+    grade_t min_grade = GRADE_EASY;
+    long max_attempts = 0;
+    uint64_t seed = 1;
+    int opt;
+    while((opt = getopt(argc, argv, "s:n:t:w:h:b:g:a:r:")) != -1) {
+        switch(opt) {
+            case 's':
+                sidelength = atoi(optarg);
+                break;
+            case 'n':
+                count = atol(optarg);
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 'w':
+                width = atoi(optarg);
+                break;
+            case 'h':
+                max_holes = atoi(optarg);
+                break;
+            case 'b':
+                budget = atol(optarg);
+                break;
+            case 'g':
+                min_grade = GRADE_HARD + 1;
+                for(int g = GRADE_EASY; g <= GRADE_HARD; g++) {
+                    if(strcmp(optarg, grade_names[g]) == 0) {
+                        min_grade = g;
+                    }
+                }
+                if(min_grade > GRADE_HARD) {
+                    printf("Invalid grade: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                max_attempts = atol(optarg);
+                break;
+            case 'r':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(argc - optind != 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    int base = 2;
+    while(base < MAX_BASE && base * base < sidelength) {
+        base++;
+    }
+    if(base * base != sidelength) {
+        printf("Invalid size: %d\n", sidelength);
+        return 1;
+    }
+    if(count < 1 || nthreads < 1 || width < 0 || max_holes < 0 || budget < 0 || max_attempts < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if(width == 0) {
+        width = nthreads;
+    }
+    if(max_holes == 0) {
+        max_holes = sidelength * sidelength;
+    }
+    if(budget == 0) {
+        budget = (long)CHECK_NODES_PER_CELL * sidelength * sidelength;
+    }
+    if(max_attempts == 0) {
+        max_attempts = min_grade > GRADE_EASY ? 100 * count : count;
+    }
+    char *path = argv[optind];
+    FILE *out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if(out == NULL) {
+        printf("Could not open %s\n", path);
+        return 1;
+    }
+
+    // One window of puzzles per round, each puzzle digging with its own tasks
+    int window = nthreads;
+    puzzle_t *puzzles = malloc(sizeof(puzzle_t) * window);
+    if(puzzles == NULL) {
+        printf("Error allocating puzzles\n");
+        return 1;
+    }
+    long kept = 0;
+    long attempts = 0;
+    long graded[GRADE_HARD + 1] = {0};
+    int status = 1;
+    double time = omp_get_wtime();
+    #pragma omp parallel num_threads(nthreads)
+    {
+        #pragma omp single
+        {
+            while(status && kept < count && attempts < max_attempts) {
+                int n_puzzles = 0;
+                while(n_puzzles < window && attempts < max_attempts) {
+                    puzzle_t *puzzle = &puzzles[n_puzzles++];
+                    puzzle->attempt = attempts++;
+                    puzzle->base = base;
+                    #pragma omp task firstprivate(puzzle)
+                    generate_puzzle(puzzle, seed, width, max_holes, budget);
+                }
+                #pragma omp taskwait
+
+                // Kept in attempt order, so the output only depends on the seed
+                for(int k = 0; k < n_puzzles && kept < count; k++) {
+                    puzzle_t *puzzle = &puzzles[k];
+                    if(puzzle->failed) {
+                        status = 0;
+                        break;
+                    }
+                    graded[puzzle->grade]++;
+                    if(puzzle->grade < min_grade) {
+                        continue;
+                    }
+                    if(!write_puzzle(out, puzzle)) {
+                        printf("Error writing %s\n", path);
+                        status = 0;
+                        break;
+                    }
+                    fprintf(stderr, "%ld givens %d propagated %d passes %ld nodes %ld grade %s\n", kept, puzzle->givens,
+                            puzzle->propagated, puzzle->passes, puzzle->nodes, grade_names[puzzle->grade]);
+                    kept++;
+                }
+                fflush(out);
+            }
+        }
+    }
+    time = omp_get_wtime() - time;
+
+    fprintf(stderr, "Puzzles: %ld of %ld tried (easy %ld medium %ld hard %ld) Size: %d Nthreads: %d time taken: %f seconds\n",
+            kept, attempts, graded[GRADE_EASY], graded[GRADE_MEDIUM], graded[GRADE_HARD], sidelength, nthreads, time);
+    if(out != stdout) {
+        fclose(out);
+    }
+    free(puzzles);
+    return status && kept == count ? 0 : 1;
+}
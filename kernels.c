@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#include "board.h"
+#include "kernels.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define KERNELS_X86 0
+#endif
+
+/*
+ * Candidate mask kernels, computing ~(rbits | cbits | bbits) for a whole array of cells.
+ *
+ * The block of a cell needs row / base and column / base. Both are below 64 and base is at
+ * most 8, so they are computed as (n * reciprocal) >> 16 with reciprocal = 2^16 / base + 1,
+ * which is exact in that range and, unlike a division, is available on vector lanes.
+ * The vector kernels split each ua_t into row and column lanes, gather the three masks
+ * and store 4 (AVX2) or 8 (AVX-512) results at a time. The kernel is picked once at
+ * startup with kernel_select(), the scalar one is used until then.
+ */
+
+_Static_assert(sizeof(ua_t) == 2, "the vector kernels load ua_t as 16 bit lanes, row in the low byte");
+
+typedef void (*kernel_fn_t)(const board_t *board, const ua_t *cells, int n, uint64_t *out);
+
+static inline uint32_t base_reciprocal(int base) {
+    return (1u << 16) / base + 1;
+}
+
+/**
+ * @brief Portable kernel, one cell at a time.
+ */
+static void candidate_masks_scalar(const board_t *board, const ua_t *cells, int n, uint64_t *out) {
+    uint32_t reciprocal = base_reciprocal(board->base);
+    int base = board->base;
+    uint64_t full = full_mask(board->sidelength);
+    for(int k = 0; k < n; k++) {
+        uint32_t row = cells[k].x;
+        uint32_t column = cells[k].y;
+        uint32_t block = ((row * reciprocal) >> 16) * base + ((column * reciprocal) >> 16);
+        out[k] = ~(uint64_t)(board->rbits[row] | board->cbits[column] | board->bbits[block]) & full;
+    }
+}
+
+#if KERNELS_X86
+
+/**
+ * @brief AVX2 kernel, 8 cells per iteration gathered as two groups of 4 masks.
+ */
+__attribute__((target("avx2")))
+static void candidate_masks_avx2(const board_t *board, const ua_t *cells, int n, uint64_t *out) {
+    const __m256i reciprocal = _mm256_set1_epi32(base_reciprocal(board->base));
+    const __m256i base = _mm256_set1_epi32(board->base);
+    const __m256i low = _mm256_set1_epi32(0xff);
+    const __m256i full = _mm256_set1_epi64x(full_mask(board->sidelength));
+    const long long *rbits = (const long long *)board->rbits;
+    const long long *cbits = (const long long *)board->cbits;
+    const long long *bbits = (const long long *)board->bbits;
+    int k = 0;
+    for(; k + 8 <= n; k += 8) {
+        __m256i cell = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(cells + k)));
+        __m256i row = _mm256_and_si256(cell, low);
+        __m256i column = _mm256_srli_epi32(cell, 8);
+        __m256i block = _mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_srli_epi32(_mm256_mullo_epi32(row, reciprocal), 16), base),
+            _mm256_srli_epi32(_mm256_mullo_epi32(column, reciprocal), 16));
+        for(int half = 0; half < 2; half++) {
+            __m128i r = half ? _mm256_extracti128_si256(row, 1) : _mm256_castsi256_si128(row);
+            __m128i c = half ? _mm256_extracti128_si256(column, 1) : _mm256_castsi256_si128(column);
+            __m128i b = half ? _mm256_extracti128_si256(block, 1) : _mm256_castsi256_si128(block);
+            __m256i used = _mm256_or_si256(_mm256_i32gather_epi64(rbits, r, 8), _mm256_i32gather_epi64(cbits, c, 8));
+            used = _mm256_or_si256(used, _mm256_i32gather_epi64(bbits, b, 8));
+            _mm256_storeu_si256((__m256i *)(out + k + 4 * half), _mm256_andnot_si256(used, full));
+        }
+    }
+    candidate_masks_scalar(board, cells + k, n - k, out + k);
+}
+
+/**
+ * @brief AVX-512 kernel, 16 cells per iteration gathered as two groups of 8 masks.
+ */
+__attribute__((target("avx512f")))
+static void candidate_masks_avx512(const board_t *board, const ua_t *cells, int n, uint64_t *out) {
+    const __m512i reciprocal = _mm512_set1_epi32(base_reciprocal(board->base));
+    const __m512i base = _mm512_set1_epi32(board->base);
+    const __m512i low = _mm512_set1_epi32(0xff);
+    const __m512i full = _mm512_set1_epi64(full_mask(board->sidelength));
+    int k = 0;
+    for(; k + 16 <= n; k += 16) {
+        __m512i cell = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(cells + k)));
+        __m512i row = _mm512_and_si512(cell, low);
+        __m512i column = _mm512_srli_epi32(cell, 8);
+        __m512i block = _mm512_add_epi32(
+            _mm512_mullo_epi32(_mm512_srli_epi32(_mm512_mullo_epi32(row, reciprocal), 16), base),
+            _mm512_srli_epi32(_mm512_mullo_epi32(column, reciprocal), 16));
+        for(int half = 0; half < 2; half++) {
+            __m256i r = half ? _mm512_extracti64x4_epi64(row, 1) : _mm512_castsi512_si256(row);
+            __m256i c = half ? _mm512_extracti64x4_epi64(column, 1) : _mm512_castsi512_si256(column);
+            __m256i b = half ? _mm512_extracti64x4_epi64(block, 1) : _mm512_castsi512_si256(block);
+            __m512i used = _mm512_or_si512(_mm512_i32gather_epi64(r, board->rbits, 8), _mm512_i32gather_epi64(c, board->cbits, 8));
+            used = _mm512_or_si512(used, _mm512_i32gather_epi64(b, board->bbits, 8));
+            _mm512_storeu_si512((void *)(out + k + 8 * half), _mm512_andnot_si512(used, full));
+        }
+    }
+    candidate_masks_scalar(board, cells + k, n - k, out + k);
+}
+
+#endif
+
+static kernel_fn_t kernel = candidate_masks_scalar;
+static const char *selected = "scalar";
+
+/**
+ * @brief Computes the candidates of every cell in cells with the selected kernel.
+ *
+ * The masks are computed whether or not the cell is filled, callers skip the filled ones.
+ *
+ * @param board Pointer to the Sudoku board structure.
+ * @param cells The cells, usually the ua array built by board_init().
+ * @param n The number of cells.
+ * @param out Output, the candidates of cells[k] as a bitmask in out[k].
+ */
+void candidate_masks(const board_t *board, const ua_t *cells, int n, uint64_t *out) {
+    kernel(board, cells, n, out);
+}
+
+/**
+ * @brief Selects the candidate kernel, must be called before any parallel region.
+ *
+ * @param name "auto" for the widest kernel the CPU supports, or one of "avx512", "avx2" and "scalar".
+ *
+ * @return 1 on success, 0 if the name is unknown or the CPU lacks the instructions.
+ */
+int kernel_select(const char *name) {
+    bool automatic = strcmp(name, "auto") == 0;
+#if KERNELS_X86
+    __builtin_cpu_init();
+    if((automatic || strcmp(name, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+        kernel = candidate_masks_avx512;
+        selected = "avx512";
+        return 1;
+    }
+    if((automatic || strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        kernel = candidate_masks_avx2;
+        selected = "avx2";
+        return 1;
+    }
+#endif
+    if(automatic || strcmp(name, "scalar") == 0) {
+        kernel = candidate_masks_scalar;
+        selected = "scalar";
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the name of the selected kernel.
+ */
+const char *kernel_name(void) {
+    return selected;
+}
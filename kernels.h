@@ -0,0 +1,10 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+void candidate_masks(const board_t *board, const ua_t *cells, int n, uint64_t *out);
+
+int kernel_select(const char *name);
+
+const char *kernel_name(void);
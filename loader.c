@@ -0,0 +1,592 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "solver.h"
+#include "board.h"
+#include "loader.h"
+
+#define MAX_CELLS 4096
+
+// Largest base whose values fit the 64 bit masks
+#define MAX_BASE 8
+
+/*
+ * Board loader for the three file formats.
+ *
+ * .dat:      base, side length and the side length^2 cells as bytes, boards back to back.
+ * text:      one board per line, blank lines and lines starting with # are skipped. A line
+ *            with spaces, tabs or commas is a list of numbers, otherwise every character is
+ *            a cell: '.' or '0' for an empty cell, then 1-9, A-Z for 10-35 and a-z for 36-61,
+ *            so 9x9 and 16x16 (1-9A-G) puzzles are written the usual way. The side length is
+ *            the square root of the number of cells.
+ * container: CONTAINER_MAGIC, the number of boards and the byte offset of every board as
+ *            64 bit integers, then the boards in the .dat layout, so board K is found without
+ *            reading the ones before it.
+ *
+ * Files are mapped with mmap, stdin and anything that cannot be mapped is read into memory.
+ */
+
+// Where malformed boards are reported, NULL for stdout
+static FILE *diagnostics = NULL;
+
+static FILE *diagnostic_stream(void) {
+    return diagnostics != NULL ? diagnostics : stdout;
+}
+
+/**
+ * @brief Sets the stream malformed boards are reported on, stdout until it is set.
+ *
+ * The service answers on stdout, so it moves the reports out of its response stream.
+ */
+void loader_diagnostics(FILE *stream) {
+    diagnostics = stream;
+}
+
+/**
+ * @brief Initializes the bitmask arrays for a Sudoku board.
+ *
+ * This function sets up the bitmask arrays for rows, columns, and blocks respectively, based on the current state 
+ * of the Sudoku board. Each bit in these arrays represents whether a number is present in the corresponding row, column, or block.
+ *
+ * @param board A pointer to the Sudoku board structure.
+ * 
+ * The function iterates through each cell of the Sudoku board. If the cell 
+ * contains a non-zero value, it updates the corresponding bitmask arrays 
+ * by setting the bit corresponding to the value in the appropriate row, column, and block.
+ *
+ * Example:
+ * - If the value at board->board[0][2] is 3, the function will set the 
+ *   bit for 3 in rbits[0], cbits[2], and the bitmask for the block 
+ *   containing the cell, and the bit of column 2 in the filled cells of row 0.
+ *
+ * If the board tracks candidate counts (board->count is set), the count of every
+ * cell is initialized to the number of values still allowed by its row, column and block,
+ * and the empty cells are added to the tally of their count, see count_init().
+ *
+ * @note The bitmask operations use 64-bit integers to represent the presence 
+ *   of numbers in rows, columns, and blocks. This means that the max size of
+ *   the Sudoku board is limited to 64x64.
+ *
+ * @return 1 on success, 0 if a value is given twice in a row, column or block, which no search could solve.
+ */
+static inline int bitmask_init(board_t *board) {
+    unsigned char base = board->base;
+    unsigned char sidelength = board->sidelength;
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            unsigned char curr_val = board->board[i][j];
+            // Checking if the value is not 0, if it is not 0, update the bitmasks
+            if(curr_val != 0) {
+                int curr_block = (i / base) * base + (j / base);
+                if((board->rbits[i] | board->cbits[j] | board->bbits[curr_block]) & VALUE_BIT(curr_val)) {
+                    fprintf(diagnostic_stream(), "Invalid value %d at row %d, column %d: already given in its row, column or block\n", curr_val, i, j);
+                    return 0;
+                }
+                board->rbits[i] |= VALUE_BIT(curr_val);
+                board->cbits[j] |= VALUE_BIT(curr_val);
+                board->bbits[curr_block] |= VALUE_BIT(curr_val);
+                if(board->filled != NULL) {
+                    board->filled[i] |= COLUMN_BIT(j);
+                }
+            }
+        }
+    }
+    if(board->count != NULL) {
+        count_init(board);
+    }
+    return 1;
+}
+
+/**
+ * @brief Finishes a board whose cells are filled in: checks the values, lists the empty cells and sets the masks.
+ *
+ * Used by every format once the cells are in place, and by callers that build boards in memory.
+ *
+ * @return 1 on success, 0 if a cell holds a value larger than the side length or one already given in its row, column or block.
+ */
+int board_finish(board_t *board, ua_t *ua, int base) {
+    int sidelength = base * base;
+    board->base = base;
+    board->sidelength = sidelength;
+    board->n_zeros = 0;
+    for(int i = 0; i < sidelength; i++) {
+        for(int j = 0; j < sidelength; j++) {
+            if(board->board[i][j] > sidelength) {
+                fprintf(diagnostic_stream(), "Invalid value %d at row %d, column %d\n", board->board[i][j], i, j);
+                return 0;
+            }
+            // If the value is zero, its unassigned which means that we add it to the unassigned array.
+            if(board->board[i][j] == 0) {
+                ua[board->n_zeros].x = i;
+                ua[board->n_zeros].y = j;
+                board->n_zeros++;
+            }
+        }
+    }
+    memset(board->rbits, 0, sizeof(int64_t) * MAX_SIDELENGTH);
+    memset(board->cbits, 0, sizeof(int64_t) * MAX_SIDELENGTH);
+    memset(board->bbits, 0, sizeof(int64_t) * MAX_SIDELENGTH);
+    if(board->filled != NULL) {
+        memset(board->filled, 0, sizeof(int64_t) * MAX_SIDELENGTH);
+    }
+    if(!bitmask_init(board)) {
+        return 0;
+    }
+    board->restart = NULL;
+    board->cells = NULL;
+    board->path = NULL;
+    board->trail_base = 0;
+    return 1;
+}
+
+/**
+ * @brief Returns the integer square root of n if n is a perfect square, -1 otherwise.
+ */
+static int exact_sqrt(int n) {
+    int root = 0;
+    while((root + 1) * (root + 1) <= n) {
+        root++;
+    }
+    return root * root == n ? root : -1;
+}
+
+/**
+ * @brief Parses a .dat board at the given offset.
+ *
+ * @return 1 on success with offset moved past the board, EOF at the end of the data, 0 on a malformed board.
+ */
+static int parse_dat(const source_t *source, size_t *offset, board_t *board, ua_t *ua) {
+    if(*offset >= source->size) {
+        return EOF;
+    }
+    if(*offset + 2 > source->size) {
+        fprintf(diagnostic_stream(), "Error reading side length\n");
+        return 0;
+    }
+    int base = source->data[*offset];
+    int sidelength = source->data[*offset + 1];
+    if(base < 1 || base > MAX_BASE || sidelength != base * base) {
+        fprintf(diagnostic_stream(), "Invalid board dimensions: base %d, side length %d\n", base, sidelength);
+        return 0;
+    }
+    if(*offset + 2 + (size_t)sidelength * sidelength > source->size) {
+        fprintf(diagnostic_stream(), "Error reading board data\n");
+        return 0;
+    }
+    const unsigned char *cells = source->data + *offset + 2;
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(board->board[i], cells + i * sidelength, sidelength);
+    }
+    *offset += 2 + (size_t)sidelength * sidelength;
+    return board_finish(board, ua, base);
+}
+
+/**
+ * @brief Returns the value of a cell character of the text format, -1 if it is not one.
+ */
+static int cell_value(unsigned char c) {
+    if(c == '.' || c == '0') {
+        return 0;
+    }
+    if(c >= '1' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'A' && c <= 'Z') {
+        return c - 'A' + 10;
+    }
+    if(c >= 'a' && c <= 'z') {
+        return c - 'a' + 36;
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds the next line holding a board, skipping blank and comment lines.
+ *
+ * @param start Output, the first character of the line.
+ * @param end Output, one past its last character, without the line break.
+ *
+ * @return false at the end of the data.
+ */
+static bool next_line(const source_t *source, size_t *offset, size_t *start, size_t *end) {
+    while(*offset < source->size) {
+        const unsigned char *line = source->data + *offset;
+        const unsigned char *newline = memchr(line, '\n', source->size - *offset);
+        size_t length = newline != NULL ? (size_t)(newline - line) : source->size - *offset;
+        *start = *offset;
+        *end = *offset + length;
+        *offset += length + (newline != NULL);
+        while(*end > *start && (source->data[*end - 1] == '\r' || source->data[*end - 1] == ' ' || source->data[*end - 1] == '\t')) {
+            (*end)--;
+        }
+        if(*end > *start && source->data[*start] != '#') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Parses the next board line of a text file.
+ *
+ * @return 1 on success with offset moved past the line, EOF at the end of the data, 0 on a malformed line.
+ */
+static int parse_text(const source_t *source, size_t *offset, board_t *board, ua_t *ua) {
+    size_t start = 0;
+    size_t end = 0;
+    if(!next_line(source, offset, &start, &end)) {
+        return EOF;
+    }
+    const unsigned char *line = source->data + start;
+    size_t length = end - start;
+    bool numbers = memchr(line, ' ', length) != NULL || memchr(line, '\t', length) != NULL || memchr(line, ',', length) != NULL;
+
+    unsigned char cells[MAX_CELLS];
+    int n = 0;
+    for(size_t k = 0; k < length; k++) {
+        unsigned char c = line[k];
+        int value;
+        if(numbers) {
+            if(c == ' ' || c == '\t' || c == ',') {
+                continue;
+            }
+            if(c == '.') {
+                value = 0;
+            } else if(c >= '0' && c <= '9') {
+                value = 0;
+                while(k < length && line[k] >= '0' && line[k] <= '9' && value <= MAX_SIDELENGTH) {
+                    value = value * 10 + line[k] - '0';
+                    k++;
+                }
+                k--;
+            } else {
+                value = -1;
+            }
+        } else {
+            value = cell_value(c);
+        }
+        if(value < 0 || value > MAX_SIDELENGTH || n == MAX_CELLS) {
+            fprintf(diagnostic_stream(), "Invalid board line: unexpected '%c'\n", c);
+            return 0;
+        }
+        cells[n++] = value;
+    }
+    int sidelength = exact_sqrt(n);
+    int base = sidelength > 0 ? exact_sqrt(sidelength) : -1;
+    if(base < 1 || base > MAX_BASE) {
+        fprintf(diagnostic_stream(), "Invalid board line: %d cells\n", n);
+        return 0;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(board->board[i], cells + i * sidelength, sidelength);
+    }
+    return board_finish(board, ua, base);
+}
+
+/**
+ * @brief Returns the offset of board index of a container.
+ */
+static size_t container_offset(const source_t *source, long index) {
+    uint64_t offset;
+    memcpy(&offset, source->data + CONTAINER_MAGIC_LEN + sizeof(uint64_t) * (1 + index), sizeof(uint64_t));
+    return offset;
+}
+
+/**
+ * @brief Reads all of a stream into memory, for stdin and files that cannot be mapped.
+ *
+ * @return 1 on success, 0 if memory ran out.
+ */
+static int read_all(source_t *source, FILE *file) {
+    size_t capacity = 1 << 16;
+    size_t size = 0;
+    unsigned char *data = malloc(capacity);
+    if(data == NULL) {
+        return 0;
+    }
+    size_t read;
+    while((read = fread(data + size, 1, capacity - size, file)) > 0) {
+        size += read;
+        if(size == capacity) {
+            unsigned char *grown = realloc(data, capacity * 2);
+            if(grown == NULL) {
+                free(data);
+                return 0;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+    }
+    source->data = data;
+    source->size = size;
+    source->mapped = false;
+    return 1;
+}
+
+/**
+ * @brief Opens a file of boards and detects its format.
+ *
+ * A container starts with CONTAINER_MAGIC and a .dat file with its base, a byte of 1 to 8,
+ * anything else is read as text.
+ *
+ * @param source Output, the opened file.
+ * @param path The path, or - for stdin.
+ *
+ * @return 1 on success, 0 if the file cannot be read or is a malformed container.
+ */
+int source_open(source_t *source, const char *path) {
+    memset(source, 0, sizeof(source_t));
+    source->count = -1;
+    if(strcmp(path, "-") == 0) {
+        if(!read_all(source, stdin)) {
+            printf("Error reading stdin\n");
+            return 0;
+        }
+    } else {
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) != 0) {
+            printf("File not found\n");
+            if(fd >= 0) {
+                close(fd);
+            }
+            return 0;
+        }
+        void *data = MAP_FAILED;
+        if(S_ISREG(st.st_mode) && st.st_size > 0) {
+            data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        if(data != MAP_FAILED) {
+            source->data = data;
+            source->size = st.st_size;
+            source->mapped = true;
+            close(fd);
+        } else {
+            FILE *file = fdopen(fd, "rb");
+            int status = file != NULL && read_all(source, file);
+            if(file != NULL) {
+                fclose(file);
+            } else {
+                close(fd);
+            }
+            if(!status) {
+                printf("Error reading %s\n", path);
+                return 0;
+            }
+        }
+    }
+
+    if(source->size >= CONTAINER_MAGIC_LEN && memcmp(source->data, CONTAINER_MAGIC, CONTAINER_MAGIC_LEN) == 0) {
+        source->format = FORMAT_CONTAINER;
+        uint64_t count = 0;
+        size_t header = CONTAINER_MAGIC_LEN + sizeof(uint64_t);
+        if(source->size >= header) {
+            memcpy(&count, source->data + CONTAINER_MAGIC_LEN, sizeof(uint64_t));
+        }
+        if(source->size < header || count > (source->size - header) / sizeof(uint64_t)) {
+            printf("Invalid container index\n");
+            source_close(source);
+            return 0;
+        }
+        source->count = count;
+    } else if(source->size > 0 && source->data[0] >= 1 && source->data[0] <= MAX_BASE) {
+        source->format = FORMAT_DAT;
+    } else {
+        source->format = FORMAT_TEXT;
+    }
+    return 1;
+}
+
+/**
+ * @brief Unmaps or frees the data of a source.
+ */
+void source_close(source_t *source) {
+    if(source->mapped) {
+        munmap((void *)source->data, source->size);
+    } else {
+        free((void *)source->data);
+    }
+    source->data = NULL;
+    source->size = 0;
+}
+
+/**
+ * @brief Positions a source so that the next call to source_next() returns board index.
+ *
+ * A container jumps straight to the board. The other formats hop over the boards before it,
+ * reading only the .dat headers or looking for the line breaks of the text.
+ *
+ * @return 1 on success, 0 if the file has fewer boards.
+ */
+int source_seek(source_t *source, long index) {
+    if(index < 0) {
+        return 0;
+    }
+    source->next = 0;
+    source->offset = 0;
+    if(source->format == FORMAT_CONTAINER) {
+        source->next = index;
+        return index < source->count;
+    }
+    for(; source->next < index; source->next++) {
+        if(source->format == FORMAT_DAT) {
+            if(source->offset + 2 > source->size) {
+                return 0;
+            }
+            size_t sidelength = source->data[source->offset + 1];
+            source->offset += 2 + sidelength * sidelength;
+        } else {
+            size_t start = 0;
+            size_t end = 0;
+            if(!next_line(source, &source->offset, &start, &end)) {
+                return 0;
+            }
+        }
+    }
+    return source->offset < source->size;
+}
+
+/**
+ * @brief Reads the next board of a source into a board and its array of unassigned cells.
+ *
+ * The buffers of the board have to be set, the cells, the masks and the counts (if the board
+ * tracks them) are filled in like board_init() does.
+ *
+ * @return 1 on success, EOF after the last board, 0 on a malformed board.
+ */
+int source_next(source_t *source, board_t *board, ua_t *ua) {
+    int status;
+    if(source->format == FORMAT_CONTAINER) {
+        if(source->next >= source->count) {
+            return EOF;
+        }
+        size_t offset = container_offset(source, source->next);
+        status = parse_dat(source, &offset, board, ua);
+        if(status == EOF) {
+            printf("Invalid container offset\n");
+            status = 0;
+        }
+    } else if(source->format == FORMAT_DAT) {
+        status = parse_dat(source, &source->offset, board, ua);
+    } else {
+        status = parse_text(source, &source->offset, board, ua);
+    }
+    source->next += status == 1;
+    return status;
+}
+
+/**
+ * @brief Loads board index of a file in any of the formats.
+ *
+ * @param path The path, or - for stdin.
+ * @param index The board to load, 0 for the first.
+ * @param board The board to fill, with its buffers set.
+ * @param ua The array of unassigned cells to fill.
+ *
+ * @return 1 on success, 0 if the file cannot be read or has no such board.
+ */
+int board_load(const char *path, long index, board_t *board, ua_t *ua) {
+    source_t source;
+    if(!source_open(&source, path)) {
+        return 0;
+    }
+    int status = source_seek(&source, index) ? source_next(&source, board, ua) : EOF;
+    if(status == EOF) {
+        printf("No board %ld in %s\n", index, path);
+    }
+    source_close(&source);
+    return status == 1;
+}
+
+/**
+ * @brief Parses one line of the text format held in memory, as a request to the service sends it.
+ *
+ * @param line The characters of the line, the line break is optional.
+ * @param length The number of characters.
+ * @param board The board to fill, with its buffers set.
+ * @param ua The array of unassigned cells to fill.
+ *
+ * @return 1 on success, EOF for a blank or comment line, 0 on a malformed line.
+ */
+int board_parse_line(const char *line, size_t length, board_t *board, ua_t *ua) {
+    source_t source = { .data = (const unsigned char *)line, .size = length, .offset = 0, .format = FORMAT_TEXT,
+                        .count = -1, .next = 0, .mapped = false };
+    return parse_text(&source, &source.offset, board, ua);
+}
+
+/**
+ * @brief Writes every board of a source to an indexed container.
+ *
+ * The source is read twice, once to find the size of every board for the index and once
+ * to copy the cells, and is left at its end.
+ *
+ * @param source The boards, in any format.
+ * @param out The stream to write the container to.
+ *
+ * @return The number of boards written, or -1 on a malformed board or a write error.
+ */
+int container_write(source_t *source, FILE *out) {
+    board_t board;
+    ua_t *ua = malloc(sizeof(ua_t) * MAX_CELLS);
+    unsigned char (*board_array)[MAX_SIDELENGTH] = malloc(sizeof(unsigned char) * MAX_SIDELENGTH * MAX_SIDELENGTH);
+    int64_t bits[4 * MAX_SIDELENGTH];
+    uint64_t *offsets = NULL;
+    long count = 0;
+    long capacity = 0;
+    int status = ua != NULL && board_array != NULL;
+    memset(&board, 0, sizeof(board_t));
+    board.board = board_array;
+    board.rbits = bits;
+    board.cbits = bits + MAX_SIDELENGTH;
+    board.bbits = bits + 2 * MAX_SIDELENGTH;
+    board.filled = bits + 3 * MAX_SIDELENGTH;
+
+    // First pass, the size of every board gives its offset
+    uint64_t offset = 0;
+    int read = EOF;
+    source_seek(source, 0);
+    while(status && (read = source_next(source, &board, ua)) == 1) {
+        if(count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 1024;
+            uint64_t *grown = realloc(offsets, sizeof(uint64_t) * capacity);
+            if(grown == NULL) {
+                status = 0;
+                break;
+            }
+            offsets = grown;
+        }
+        offsets[count++] = offset;
+        offset += 2 + (uint64_t)board.sidelength * board.sidelength;
+    }
+    status = status && read != 0;
+    if(status) {
+        uint64_t header = CONTAINER_MAGIC_LEN + sizeof(uint64_t) * (1 + count);
+        for(long k = 0; k < count; k++) {
+            offsets[k] += header;
+        }
+        uint64_t n = count;
+        status = fwrite(CONTAINER_MAGIC, 1, CONTAINER_MAGIC_LEN, out) == CONTAINER_MAGIC_LEN
+              && fwrite(&n, sizeof(uint64_t), 1, out) == 1
+              && fwrite(offsets, sizeof(uint64_t), count, out) == (size_t)count;
+    }
+    // Second pass, the cells
+    source_seek(source, 0);
+    for(long k = 0; status && k < count; k++) {
+        status = source_next(source, &board, ua) == 1;
+        unsigned char header[2] = {board.base, board.sidelength};
+        status = status && fwrite(header, 1, 2, out) == 2;
+        for(int i = 0; status && i < board.sidelength; i++) {
+            status = fwrite(board.board[i], 1, board.sidelength, out) == board.sidelength;
+        }
+    }
+    free(ua);
+    free(board_array);
+    free(offsets);
+    return status ? count : -1;
+}
@@ -0,0 +1,44 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "solver.h"
+#pragma once
+
+// First bytes of an indexed container, followed by the board count and one offset per board
+#define CONTAINER_MAGIC "SUDOKUC1"
+#define CONTAINER_MAGIC_LEN 8
+
+typedef enum {
+    FORMAT_DAT,         // Back to back boards: base, side length, side length^2 cells
+    FORMAT_TEXT,        // One board per line, characters or whitespace separated numbers
+    FORMAT_CONTAINER    // Indexed container of .dat boards, see container_write()
+} board_format_t;
+
+// A file of boards, mapped or read into memory once
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t offset;          // Where the next board starts
+    board_format_t format;
+    long count;             // Boards in a container, -1 for the other formats
+    long next;              // Index of the next board
+    bool mapped;
+} source_t;
+
+int board_finish(board_t *board, ua_t *ua, int base);
+
+void loader_diagnostics(FILE *stream);
+
+int source_open(source_t *source, const char *path);
+
+void source_close(source_t *source);
+
+int source_seek(source_t *source, long index);
+
+int source_next(source_t *source, board_t *board, ua_t *ua);
+
+int board_load(const char *path, long index, board_t *board, ua_t *ua);
+
+int board_parse_line(const char *line, size_t length, board_t *board, ua_t *ua);
+
+int container_write(source_t *source, FILE *out);
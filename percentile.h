@@ -0,0 +1,26 @@
+#include <stdlib.h>
+#pragma once
+
+/*
+ * Order statistics over timings, shared by the batch summary and the benchmark.
+ */
+
+/**
+ * @brief qsort() comparator for an ascending array of doubles.
+ */
+static inline int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Returns the p-th percentile of a sorted array with the nearest-rank method.
+ */
+static inline double percentile(const double *sorted, long n, double p) {
+    long rank = (long)(p / 100.0 * n + 0.999999);
+    if(rank < 1) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "solver.h"
+#include "pool.h"
+
+#define CACHE_LINE 64
+#define MAX_POOL_THREADS 256
+
+// One free list per side length, with and without candidate counts
+#define SIZE_CLASSES (2 * (MAX_SIDELENGTH + 1))
+
+/*
+ * Per-thread pool of task board slabs.
+ *
+ * A slab holds everything a task board points to in one cache-line aligned block: the three
+ * bitmask arrays, the filled cells of the rows and optionally the used rows of the candidate
+ * counts and of their tally, all sized to the side length. Task boards share the grid of the search. Tasks are
+ * tied, so a slab is always returned by the thread that took it and each thread only ever
+ * touches its own free lists, which therefore need no locks.
+ */
+
+typedef struct slab_s {
+    struct slab_s *next;
+} slab_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) slab_t *free[SIZE_CLASSES];
+    long requests;          // Slabs handed out
+    long allocations;       // Slabs that had to be allocated
+    long in_use;
+    long peak;
+} pool_thread_t;
+
+static pool_thread_t pools[MAX_POOL_THREADS];
+
+static inline int size_class(int sidelength, bool count) {
+    return 2 * sidelength + count;
+}
+
+static inline size_t slab_bytes(int sidelength, bool count) {
+    size_t bytes = 4 * sizeof(int64_t) * sidelength;
+    if(count) {
+        bytes += sizeof(uint64_t) * (sidelength + 1) + (size_t)sidelength * (2 * MAX_SIDELENGTH + 1);
+    }
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+/**
+ * @brief Returns the pool of the calling thread, or NULL if the team is larger than the pool table.
+ */
+static inline pool_thread_t *thread_pool(void) {
+    int thread = omp_get_thread_num();
+    return thread < MAX_POOL_THREADS ? &pools[thread] : NULL;
+}
+
+/**
+ * @brief Points the buffers of a board at a slab from the calling thread's pool.
+ *
+ * The masks come first so they start on a cache line, followed by the filled cells, the rows
+ * of the tally, the counts and the tally.
+ * The filled cells are only attached when the board tracks them, board->filled is set then.
+ *
+ * @param board The board to attach, its other fields are left alone.
+ * @param sidelength The side length the slab is sized for.
+ * @param count Whether the board tracks candidate counts.
+ *
+ * @return 1 on success, 0 if a new slab could not be allocated.
+ */
+int pool_attach(board_t *board, int sidelength, bool count) {
+    pool_thread_t *pool = thread_pool();
+    int class = size_class(sidelength, count);
+    slab_t *slab = NULL;
+    if(pool != NULL) {
+        pool->requests++;
+        slab = pool->free[class];
+        if(slab != NULL) {
+            pool->free[class] = slab->next;
+        }
+    }
+    if(slab == NULL) {
+        slab = aligned_alloc(CACHE_LINE, slab_bytes(sidelength, count));
+        if(slab == NULL) {
+            return 0;
+        }
+        if(pool != NULL) {
+            pool->allocations++;
+        }
+    }
+    if(pool != NULL && ++pool->in_use > pool->peak) {
+        pool->peak = pool->in_use;
+    }
+    board->rbits = (int64_t *)slab;
+    board->cbits = board->rbits + sidelength;
+    board->bbits = board->cbits + sidelength;
+    board->filled = board->filled != NULL ? board->bbits + sidelength : NULL;
+    board->tally_rows = count ? (uint64_t *)(board->bbits + 2 * sidelength) : NULL;
+    unsigned char *bytes = (unsigned char *)(board->bbits + 3 * sidelength + 1);
+    board->count = count ? (unsigned char (*)[MAX_SIDELENGTH])bytes : NULL;
+    board->tally = count ? (unsigned char (*)[MAX_SIDELENGTH + 1])(bytes + (size_t)sidelength * MAX_SIDELENGTH) : NULL;
+    return 1;
+}
+
+/**
+ * @brief Gives the slab of a board back to the calling thread's pool.
+ *
+ * @param board A board attached with pool_attach() on the same thread, with the same side length.
+ */
+void pool_detach(board_t *board) {
+    slab_t *slab = (slab_t *)board->rbits;
+    pool_thread_t *pool = thread_pool();
+    if(pool == NULL) {
+        free(slab);
+        return;
+    }
+    int class = size_class(board->sidelength, board->count != NULL);
+    slab->next = pool->free[class];
+    pool->free[class] = slab;
+    pool->in_use--;
+}
+
+/**
+ * @brief Prints the slab requests, the allocations and the peak number of slabs in use.
+ *
+ * The peak is summed over the threads, so it is an upper bound on the slabs alive at once.
+ */
+void pool_report(void) {
+    long requests = 0;
+    long allocations = 0;
+    long peak = 0;
+    for(int t = 0; t < MAX_POOL_THREADS; t++) {
+        requests += pools[t].requests;
+        allocations += pools[t].allocations;
+        peak += pools[t].peak;
+    }
+    printf("Board pool: %ld requests, %ld allocations, peak %ld slabs in use\n", requests, allocations, peak);
+}
+
+/**
+ * @brief Frees every slab held by the pools and resets the statistics.
+ *
+ * Must be called outside of a parallel region.
+ */
+void pool_release(void) {
+    for(int t = 0; t < MAX_POOL_THREADS; t++) {
+        for(int class = 0; class < SIZE_CLASSES; class++) {
+            while(pools[t].free[class] != NULL) {
+                slab_t *next = pools[t].free[class]->next;
+                free(pools[t].free[class]);
+                pools[t].free[class] = next;
+            }
+        }
+        memset(&pools[t], 0, sizeof(pool_thread_t));
+    }
+}
@@ -0,0 +1,12 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+int pool_attach(board_t *board, int sidelength, bool count);
+
+void pool_detach(board_t *board);
+
+void pool_report(void);
+
+void pool_release(void);
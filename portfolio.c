@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "portfolio.h"
+
+/*
+ * Portfolio mode: several differently configured bitmask searches race on copies of the
+ * same board and the first solution wins.
+ *
+ * The time of a search on a hard board swings by orders of magnitude with the cell and the
+ * value order, and which order is fast differs from board to board. Racing a few orders
+ * bounds the time by the fastest of them instead of betting on one. The members share one
+ * search_t, so the winner's compare and swap on the found flag stops every other member on
+ * its next node, exactly like it stops the other tasks of a single search.
+ *
+ * Every member is a task on the calling team. When the team has more threads than members
+ * the members also spawn tasks in their first levels (the cutoff scheduler), and the spare
+ * threads pick those up, so the threads are shared out among the members by the task pool.
+ */
+
+// Task levels of every member when the team has threads to spare and no cutoff is given
+#define PORTFOLIO_CUTOFF 2
+
+// A member's board and the buffers behind it, the cells are those of the board raced on. The
+// filled cells and the counts are the member's own, so a member can order the cells differently.
+typedef struct {
+    board_t board;
+    solver_opts_t opts;
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
+    int64_t bits[4 * MAX_SIDELENGTH];
+} member_t;
+
+/**
+ * @brief Fills the options of member k of a portfolio built on the given options.
+ *
+ * Member 0 is the search the options describe, member 1 tries the values the other way
+ * round, member 2 switches the fixed cell order to MRV and MRV or dom/wdeg to the fixed one,
+ * and every other member draws its value order, and its MRV ties, from its own seed.
+ * Every member uses the bitmask engine with the cutoff scheduler and never counts.
+ *
+ * @param opts The options given to the solver.
+ * @param k The member.
+ * @param member Output, the options of the member.
+ */
+void portfolio_member(const solver_opts_t *opts, int k, solver_opts_t *member) {
+    *member = *opts;
+    member->engine = ENGINE_BITMASK;
+    member->scheduler = SCHED_CUTOFF;
+    member->count = false;
+    member->limit = 0;
+    if(k == 1) {
+        member->values = opts->values == VALUES_HIGH ? VALUES_LOW : VALUES_HIGH;
+    } else if(k == 2) {
+        member->order = opts->order == ORDER_FIXED ? ORDER_MRV : ORDER_FIXED;
+    } else if(k >= 2) {
+        member->values = VALUES_RANDOM;
+        member->seed = opts->seed + k;
+    }
+}
+
+/**
+ * @brief Races members differently configured searches on the board, see portfolio_member().
+ *
+ * Has to be called from a single thread inside a parallel region, like run_engine(). At most
+ * one member runs per thread of the team, since a member waiting for a thread is no help in
+ * a race. The winning solution is copied to the board once every member has stopped.
+ *
+ * A member whose cell order needs the filled cells or the counts the board does not track
+ * builds them itself. The board then has no filled cells, so it does not propagate and the
+ * cells of its grid are all that is filled.
+ *
+ * @param ua The array of unassigned cells built by board_init(), shared by the members.
+ * @param board The loaded board, its options are those of member 0.
+ * @param zeroes The number of empty cells left.
+ * @param members The searches to race.
+ * @param cutoff Task levels of every member, 0 for PORTFOLIO_CUTOFF when the team has more
+ *        threads than members and a sequential search per member otherwise.
+ *
+ * @return The member that found the solution, -1 if there is none.
+ */
+int portfolio_solver(ua_t *ua, board_t *board, short int zeroes, int members, int cutoff) {
+    int nthreads = omp_get_num_threads();
+    if(members > nthreads) {
+        members = nthreads;
+    }
+    if(members > MAX_MEMBERS) {
+        members = MAX_MEMBERS;
+    }
+    if(cutoff == 0 && nthreads > members) {
+        cutoff = PORTFOLIO_CUTOFF;
+    }
+    member_t *member = malloc(sizeof(member_t) * members);
+    if(member == NULL) {
+        printf("Error allocating portfolio\n");
+        return -1;
+    }
+    for(int k = 0; k < members; k++) {
+        member_t *m = &member[k];
+        portfolio_member(board->opts, k, &m->opts);
+        m->board = *board;
+        m->board.rbits = m->bits;
+        m->board.cbits = m->bits + MAX_SIDELENGTH;
+        m->board.bbits = m->bits + 2 * MAX_SIDELENGTH;
+        m->board.filled = tracks_filled(&m->opts) ? m->bits + 3 * MAX_SIDELENGTH : NULL;
+        m->board.count = m->opts.order != ORDER_FIXED ? m->count_array : NULL;
+        m->board.tally = m->board.count != NULL ? m->tally_array : NULL;
+        m->board.tally_rows = m->board.count != NULL ? m->tally_rows : NULL;
+        m->board.opts = &m->opts;
+        board_copy(&m->board, board);
+        if(m->board.filled != NULL && board->filled == NULL) {
+            for(int i = 0; i < board->sidelength; i++) {
+                m->board.filled[i] = 0;
+                for(int j = 0; j < board->sidelength; j++) {
+                    if(board->board[i][j] != 0) {
+                        m->board.filled[i] |= COLUMN_BIT(j);
+                    }
+                }
+            }
+        }
+        if(m->board.count != NULL && board->count == NULL) {
+            count_init(&m->board);
+        }
+    }
+    for(int k = 0; k < members; k++) {
+        member_t *m = &member[k];
+        #pragma omp task firstprivate(m)
+        solver(ua, &m->board, zeroes, cutoff);
+    }
+    #pragma omp taskwait
+
+    int winner = -1;
+    for(int k = 0; k < members; k++) {
+        if(board->search->winner == &member[k].opts) {
+            winner = k;
+        }
+    }
+    if(winner >= 0) {
+        memcpy(board->board, board->search->solution, grid_bytes(board->sidelength));
+    }
+    free(member);
+    return winner;
+}
@@ -0,0 +1,11 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+// Most searches a portfolio races
+#define MAX_MEMBERS 16
+
+void portfolio_member(const solver_opts_t *opts, int k, solver_opts_t *member);
+
+int portfolio_solver(ua_t *ua, board_t *board, short int zeroes, int members, int cutoff);
@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "propagate.h"
+#include "kernels.h"
+#include "stats.h"
+
+// Cells placed by propagation, and the value of a task of solver() until it moves to the path of
+// the task, one trail per thread. The sequential branch of solver() never reaches a task
+// scheduling point, so the entries it pushes are always popped on the same thread.
+decision_t trail[TRAIL_CELLS];
+int trail_len = 0;
+#pragma omp threadprivate(trail, trail_len)
+
+/**
+ * @brief Places a value on the masks of a board of the given base and records it on the calling thread's trail.
+ */
+static inline __attribute__((always_inline)) void trail_place_base(board_t *board, int base, int row, int column, int value) {
+    bit_update_base(board, base, row, column, value, true);
+    trail[trail_len].cell.x = row;
+    trail[trail_len].cell.y = column;
+    trail[trail_len].value = value;
+    trail_len++;
+}
+
+/**
+ * @brief Places a value on the masks of the board and records it on the calling thread's trail.
+ */
+void trail_place(board_t *board, int row, int column, int value) {
+    trail_place_base(board, board->base, row, column, value);
+}
+
+/**
+ * @brief Fills naked singles, cells with exactly one candidate left.
+ *
+ * The candidates of all cells are computed up front by the vector kernel. Placements later in
+ * the pass can only take candidates away, so a cell that shows a single is rechecked against the
+ * current masks before it is filled, and a cell that only became a single is left for the next pass.
+ *
+ * @return -1 if some empty cell has no candidates, otherwise the number of cells filled.
+ */
+static inline __attribute__((always_inline)) int naked_singles(board_t *board, ua_t *ua, const int base) {
+    uint64_t cand[board->n_zeros];
+    candidate_masks(board, ua, board->n_zeros, cand);
+    int filled = 0;
+    for(int k = 0; k < board->n_zeros; k++) {
+        int row = ua[k].x;
+        int column = ua[k].y;
+        if(!cell_empty(board, row, column) || (cand[k] & (cand[k] - 1)) != 0) {
+            continue;
+        }
+        uint64_t current = cand[k] != 0 ? candidates_base(board, base, row, column) : 0;
+        if(current == 0) {
+            return -1;
+        }
+        trail_place_base(board, base, row, column, __builtin_ctzll(current) + 1);
+        filled++;
+    }
+    return filled;
+}
+
+/**
+ * @brief Fills hidden singles, values with only one legal place left in a row, column or block.
+ *
+ * One pass over the candidates of the empty cells, computed by the vector kernel, collects, for every unit, the values that are a candidate
+ * in at least one (once) and at least two (twice) of its cells. A missing value outside of
+ * once has nowhere to go, a missing value in once but not in twice is a hidden single. A second
+ * pass places the hidden singles, rechecking each cell against the current masks since earlier
+ * placements in the same pass may have taken the value away. The stale candidates are a superset
+ * of the current ones, so they still rule out cells without a hidden single.
+ *
+ * @return -1 on a contradiction, otherwise the number of cells filled.
+ */
+static inline __attribute__((always_inline)) int hidden_singles(board_t *board, ua_t *ua, const int base) {
+    const int sidelength = base * base;
+    uint64_t once[3][MAX_SIDELENGTH] = {{0}};
+    uint64_t twice[3][MAX_SIDELENGTH] = {{0}};
+    uint64_t full = full_mask(sidelength);
+    uint64_t cand[board->n_zeros];
+    candidate_masks(board, ua, board->n_zeros, cand);
+    for(int k = 0; k < board->n_zeros; k++) {
+        int row = ua[k].x;
+        int column = ua[k].y;
+        if(!cell_empty(board, row, column)) {
+            continue;
+        }
+        int unit[3] = {row, column, block_index_base(base, row, column)};
+        for(int u = 0; u < 3; u++) {
+            twice[u][unit[u]] |= once[u][unit[u]] & cand[k];
+            once[u][unit[u]] |= cand[k];
+        }
+    }
+
+    // Reuse once[] for the hidden singles of each unit
+    bool found = false;
+    int64_t *bits[3] = {board->rbits, board->cbits, board->bbits};
+    for(int u = 0; u < 3; u++) {
+        for(int i = 0; i < sidelength; i++) {
+            uint64_t missing = ~(uint64_t)bits[u][i] & full;
+            if(missing & ~once[u][i]) {
+                return -1;
+            }
+            once[u][i] &= ~twice[u][i] & missing;
+            found |= once[u][i] != 0;
+        }
+    }
+    if(!found) {
+        return 0;
+    }
+
+    int filled = 0;
+    for(int k = 0; k < board->n_zeros; k++) {
+        int row = ua[k].x;
+        int column = ua[k].y;
+        if(!cell_empty(board, row, column)) {
+            continue;
+        }
+        int block = block_index_base(base, row, column);
+        if((cand[k] & (once[0][row] | once[1][column] | once[2][block])) == 0) {
+            continue;
+        }
+        uint64_t hidden = candidates_base(board, base, row, column) & (once[0][row] | once[1][column] | once[2][block]);
+        if(hidden == 0) {
+            continue;
+        }
+        // The cell is the only place for two different values
+        if(hidden & (hidden - 1)) {
+            return -1;
+        }
+        trail_place_base(board, base, row, column, __builtin_ctzll(hidden) + 1);
+        filled++;
+    }
+    return filled;
+}
+
+/**
+ * @brief Runs naked and hidden singles on a board of the given base until neither of them fills a cell.
+ *
+ * Always inlined, once per base of SPECIALIZED_BASES with base a constant, like the sequential
+ * searches of solver.c, and once in the generic pass with the base of the board.
+ */
+static inline __attribute__((always_inline)) bool propagate_base(board_t *board, ua_t *ua, short int *placed, const int base) {
+    *placed = 0;
+    while(true) {
+        stats_pass();
+        int filled = naked_singles(board, ua, base);
+        if(filled < 0) {
+            return false;
+        }
+        *placed += filled;
+        if(filled > 0) {
+            continue;
+        }
+        filled = hidden_singles(board, ua, base);
+        if(filled < 0) {
+            return false;
+        }
+        *placed += filled;
+        if(filled == 0) {
+            return true;
+        }
+    }
+}
+
+static bool propagate_generic(board_t *board, ua_t *ua, short int *placed) {
+    return propagate_base(board, ua, placed, board->base);
+}
+
+#define PROPAGATE_VARIANT(B) \
+static bool propagate_##B(board_t *board, ua_t *ua, short int *placed) { \
+    return propagate_base(board, ua, placed, B); \
+}
+SPECIALIZED_BASES(PROPAGATE_VARIANT)
+
+/**
+ * @brief Runs naked and hidden singles until neither of them fills a cell.
+ *
+ * Every cell filled is pushed on the calling thread's trail, so a caller that wants to backtrack
+ * takes a trail_mark() first and calls trail_undo() with it afterwards. Callers working on a
+ * private board copy that is thrown away can simply reset the trail with trail_undo(NULL, mark),
+ * once they kept the values with trail_save() or trail_fill() if they need them. The pass for
+ * the base of the board is picked here, see propagate_base().
+ *
+ * @param board Pointer to the Sudoku board structure.
+ * @param ua The array of unassigned cells built by board_init().
+ * @param placed Output, the number of cells filled (also when a contradiction is found).
+ *
+ * @return false if the board was found to have no solution, true otherwise.
+ */
+bool propagate(board_t *board, ua_t *ua, short int *placed) {
+    switch(board->base) {
+        #define PROPAGATE_CASE(B) case B: return propagate_##B(board, ua, placed);
+        SPECIALIZED_BASES(PROPAGATE_CASE)
+        default: return propagate_generic(board, ua, placed);
+    }
+}
+
+/**
+ * @brief Restores the bitmasks of the board for every value pushed on the trail after mark, see trail_undo().
+ */
+void trail_restore(board_t *board, int mark) {
+    while(trail_len > mark) {
+        trail_len--;
+        bit_update(board, trail[trail_len].cell.x, trail[trail_len].cell.y, trail[trail_len].value, false);
+    }
+}
+
+/**
+ * @brief Moves the entries pushed on the trail after mark to cells, leaving the trail at mark.
+ *
+ * @param mark A position returned by trail_mark().
+ * @param cells Output, room for trail_mark() - mark entries.
+ * @return The number of entries moved.
+ */
+int trail_save(int mark, decision_t *cells) {
+    int n = trail_len - mark;
+    memcpy(cells, trail + mark, sizeof(decision_t) * n);
+    trail_len = mark;
+    return n;
+}
+
+/**
+ * @brief Writes the values pushed on the trail from position from on into a grid.
+ */
+void trail_fill(unsigned char (*grid)[MAX_SIDELENGTH], int from) {
+    for(int k = from; k < trail_len; k++) {
+        grid[trail[k].cell.x][trail[k].cell.y] = trail[k].value;
+    }
+}
@@ -0,0 +1,45 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#include "board.h"
+#pragma once
+
+// Room for two searches of a full board, a work-stealing search can run a helper inside its own
+#define TRAIL_CELLS (2 * MAX_SIDELENGTH * MAX_SIDELENGTH)
+
+// Values placed on the boards of the calling thread in the order they were placed, see propagate.c
+extern decision_t trail[TRAIL_CELLS];
+extern int trail_len;
+#pragma omp threadprivate(trail, trail_len)
+
+bool propagate(board_t *board, ua_t *ua, short int *placed);
+
+void trail_place(board_t *board, int row, int column, int value);
+
+void trail_restore(board_t *board, int mark);
+
+int trail_save(int mark, decision_t *cells);
+
+void trail_fill(unsigned char (*grid)[MAX_SIDELENGTH], int from);
+
+/**
+ * @brief Returns the current position of the calling thread's trail.
+ */
+static inline int trail_mark(void) {
+    return trail_len;
+}
+
+/**
+ * @brief Takes back every value pushed on the trail after mark and restores the bitmasks.
+ *
+ * Inlined down to a compare when there is nothing to take back, the loop is trail_restore().
+ *
+ * @param board The board the values were placed on, or NULL to only drop the entries.
+ * @param mark A position returned by trail_mark().
+ */
+static inline void trail_undo(board_t *board, int mark) {
+    if(board != NULL && trail_len > mark) {
+        trail_restore(board, mark);
+    }
+    trail_len = mark;
+}
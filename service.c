@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "loader.h"
+#include "canon.h"
+#include "service.h"
+
+#define MAX_CELLS 4096
+
+// Connections waiting to be accepted by the service
+#define SERVICE_BACKLOG 16
+
+/*
+ * Long running solve service.
+ *
+ * One team of threads is created when the service starts and lives until it stops, the
+ * thread that reads the requests runs every search on it like the solver does for a single
+ * board. Requests are text board lines, one per line, answered in order with the result lines
+ * of batch mode: "<n> solved <sidelength> <cells>", "<n> unsolvable" or "<n> invalid", with
+ * n counting the puzzles of the stream. A malformed line is answered "<n> error", the reason
+ * is printed on stderr so every request keeps a single response line. The line "stats" is
+ * answered with the counters of the cache and "shutdown" stops the service.
+ *
+ * Every puzzle is brought to its canonical form (canon.c) and solved in that form, the
+ * solution is cached under the form and mapped back to the puzzle. A puzzle equivalent to
+ * one solved before, up to relabeling, line permutations and transposition, is answered
+ * from the cache without a search.
+ */
+
+// Buffers of the board a request is solved on
+typedef struct {
+    board_t board;
+    search_t search;
+    ua_t ua[MAX_CELLS];
+    unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
+    unsigned char canonical[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char solution[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    int64_t bits[4 * MAX_SIDELENGTH];
+} request_t;
+
+typedef struct {
+    const solver_opts_t *opts;
+    int cutoff;
+    cache_t cache;
+    request_t *request;
+    long requests;
+    double hit_time;        // Seconds spent answering hits
+    double miss_time;       // Seconds spent answering misses
+    bool stop;
+} service_t;
+
+/**
+ * @brief Points the board of a request at its buffers.
+ */
+static void request_attach(request_t *request, const solver_opts_t *opts) {
+    request->board.board = request->board_array;
+    request->board.rbits = request->bits;
+    request->board.cbits = request->bits + MAX_SIDELENGTH;
+    request->board.bbits = request->bits + 2 * MAX_SIDELENGTH;
+    request->board.filled = tracks_filled(opts) ? request->bits + 3 * MAX_SIDELENGTH : NULL;
+    request->board.count = opts->order != ORDER_FIXED ? request->count_array : NULL;
+    request->board.tally = request->board.count != NULL ? request->tally_array : NULL;
+    request->board.tally_rows = request->board.count != NULL ? request->tally_rows : NULL;
+    request->board.opts = opts;
+    request->board.search = &request->search;
+}
+
+/**
+ * @brief Solves the canonical form held in request->canonical.
+ *
+ * @return true with the solution in request->solution, false if there is none.
+ */
+static bool solve_canonical(service_t *service, request_t *request, int base) {
+    int sidelength = base * base;
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(request->board_array[i], request->canonical[i], sidelength);
+    }
+    search_init(&request->search, true);
+    if(!board_finish(&request->board, request->ua, base)) {
+        return false;
+    }
+    short int zeroes = load_propagate(&request->board, request->ua);
+    if(zeroes < 0) {
+        return false;
+    }
+    run_engine(request->ua, &request->board, zeroes, service->cutoff);
+    if(!search_done(&request->search) || !request->search.valid) {
+        return false;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        memcpy(request->solution[i], request->board_array[i], sidelength);
+    }
+    return true;
+}
+
+/**
+ * @brief Answers one request line on a stream.
+ */
+static void answer(service_t *service, char *line, size_t length, FILE *out) {
+    while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+        length--;
+    }
+    if(length == 5 && strncmp(line, "stats", 5) == 0) {
+        cache_t *cache = &service->cache;
+        fprintf(out, "stats requests %ld hits %ld misses %ld entries %ld\n", service->requests, cache->hits,
+                cache->misses, cache->stored);
+        return;
+    }
+    if(length == 8 && strncmp(line, "shutdown", 8) == 0) {
+        service->stop = true;
+        return;
+    }
+
+    double time = omp_get_wtime();
+    request_t *request = service->request;
+    request_attach(request, service->opts);
+    int read = board_parse_line(line, length, &request->board, request->ua);
+    if(read == EOF) {
+        return;
+    }
+    long n = service->requests++;
+    if(read == 0) {
+        fprintf(out, "%ld error\n", n);
+        return;
+    }
+    int base = request->board.base;
+    int sidelength = request->board.sidelength;
+    canon_t canon;
+    uint64_t hash = canon_form(request->board_array, base, &canon, request->canonical);
+    int cached = cache_lookup(&service->cache, hash, base, request->canonical, request->solution);
+    bool solved = cached == 1;
+    bool invalid = false;
+    if(cached < 0) {
+        solved = solve_canonical(service, request, base);
+        // A solution that failed verification is reported, never cached
+        invalid = !solved && search_done(&request->search) && !request->search.valid;
+        if(!invalid) {
+            cache_store(&service->cache, hash, base, request->canonical, solved ? request->solution : NULL);
+        }
+    }
+    if(solved) {
+        canon_restore(&canon, request->solution, request->board_array);
+        fprintf(out, "%ld solved %d", n, sidelength);
+        for(int i = 0; i < sidelength; i++) {
+            for(int j = 0; j < sidelength; j++) {
+                fprintf(out, " %d", request->board_array[i][j]);
+            }
+        }
+        fprintf(out, "\n");
+    } else if(invalid) {
+        fprintf(out, "%ld invalid\n", n);
+    } else {
+        fprintf(out, "%ld unsolvable\n", n);
+    }
+    time = omp_get_wtime() - time;
+    if(cached < 0) {
+        service->miss_time += time;
+    } else {
+        service->hit_time += time;
+    }
+}
+
+/**
+ * @brief Answers the requests of a stream until it ends or asks the service to stop.
+ */
+static void serve_stream(service_t *service, FILE *in, FILE *out) {
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    while(!service->stop && (length = getline(&line, &size, in)) != -1) {
+        answer(service, line, length, out);
+        fflush(out);
+    }
+    free(line);
+}
+
+/**
+ * @brief Listens on a Unix domain socket and serves one connection after the other.
+ *
+ * @return 1 once a request stopped the service, 0 if the socket cannot be set up.
+ */
+static int serve_socket(service_t *service, const char *path) {
+    struct sockaddr_un addr;
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Socket path too long: %s\n", path);
+        return 0;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        printf("Could not create socket\n");
+        return 0;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    // Only a socket left behind by an earlier run is replaced, never another file
+    struct stat existing;
+    if(lstat(path, &existing) == 0) {
+        if(!S_ISSOCK(existing.st_mode)) {
+            printf("Could not listen on %s\n", path);
+            close(fd);
+            return 0;
+        }
+        unlink(path);
+    }
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVICE_BACKLOG) != 0) {
+        printf("Could not listen on %s\n", path);
+        close(fd);
+        return 0;
+    }
+    fprintf(stderr, "Listening on %s\n", path);
+    while(!service->stop) {
+        int client = accept(fd, NULL, NULL);
+        if(client < 0) {
+            continue;
+        }
+        // Separate streams for both directions, each closes its own descriptor
+        int client_out = dup(client);
+        FILE *in = fdopen(client, "r");
+        FILE *out = client_out >= 0 ? fdopen(client_out, "w") : NULL;
+        if(in != NULL && out != NULL) {
+            serve_stream(service, in, out);
+        }
+        if(in != NULL) {
+            fclose(in);
+        } else {
+            close(client);
+        }
+        if(out != NULL) {
+            fclose(out);
+        } else if(client_out >= 0) {
+            close(client_out);
+        }
+    }
+    close(fd);
+    unlink(path);
+    return 1;
+}
+
+/**
+ * @brief Runs the solve service on stdin and stdout, or on a Unix domain socket.
+ *
+ * @param socket_path The socket to listen on, NULL to read requests from stdin and answer on stdout.
+ * @param opts The solver options used for every puzzle, counting is not supported.
+ * @param nthreads The number of threads of the team kept for the whole service.
+ * @param cutoff The task cutoff, only used by the cutoff scheduler.
+ * @param cache_size The number of results the cache holds.
+ *
+ * @return 1 if the service ran until its input ended or a request stopped it, 0 otherwise.
+ */
+int service_run(const char *socket_path, const solver_opts_t *opts, int nthreads, int cutoff, long cache_size) {
+    service_t service = { .opts = opts, .cutoff = cutoff, .request = malloc(sizeof(request_t)), .requests = 0,
+                          .hit_time = 0, .miss_time = 0, .stop = false };
+    if(service.request == NULL || !cache_init(&service.cache, cache_size)) {
+        printf("Error allocating service\n");
+        free(service.request);
+        return 0;
+    }
+    // A client that goes away mid answer must not take the service down with it
+    signal(SIGPIPE, SIG_IGN);
+    // Answers are one line per request, the reason a line is malformed goes to stderr
+    loader_diagnostics(stderr);
+    int status = 1;
+    #pragma omp parallel num_threads(nthreads)
+    {
+        #pragma omp single
+        {
+            if(socket_path != NULL) {
+                status = serve_socket(&service, socket_path);
+            } else {
+                serve_stream(&service, stdin, stdout);
+            }
+        }
+    }
+    cache_t *cache = &service.cache;
+    fprintf(stderr, "Requests: %ld cache hits: %ld misses: %ld Nthreads: %d mean ms: hit %.3f miss %.3f\n",
+            service.requests, cache->hits, cache->misses, nthreads,
+            cache->hits > 0 ? service.hit_time / cache->hits * 1e3 : 0.0,
+            cache->misses > 0 ? service.miss_time / cache->misses * 1e3 : 0.0);
+    cache_free(cache);
+    free(service.request);
+    return status;
+}
@@ -0,0 +1,6 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+int service_run(const char *socket_path, const solver_opts_t *opts, int nthreads, int cutoff, long cache_size);
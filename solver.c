@@ -5,22 +5,47 @@
 #include <stdbool.h>
 #include <omp.h>
 #include <stdint.h>  
+#include <limits.h>
+#include <unistd.h>
+#include <signal.h>
 #include "verify.h"
 #include "solver.h"
+#include "board.h"
+#include "propagate.h"
+#include "dlx.h"
+#include "steal.h"
+#include "batch.h"
+#include "loader.h"
+#include "pool.h"
+#include "kernels.h"
+#include "stats.h"
+#include "portfolio.h"
+#include "service.h"
+#include "affinity.h"
+#include "checkpoint.h"
+#include "distrib.h"
 
 // Defining the max size of the board
 #define MAX_SIDELENGTH 64
 #define MAX_CELLS 4096
 
-// Switch to 1 for performance testing
-#define PERFORMANCE 0
-
-// Switch to 1 if you want to allocate memory on the heap instead of the stack
+// Switch to 1 if you want task boards to come from the per-thread slab pool instead of the stack
 #define HEAP_ALLOCATION 0
 
+// Results the cache of the service holds unless -C gives the number
+#define SERVICE_CACHE 4096
+
+// Nodes of the first run of a restarting search unless -R gives them
+#define RESTART_NODES 1000
+
+// Growth of the runs of RESTART_GEOMETRIC from one restart to the next
+#define RESTART_GROWTH 1.5
+
+// Cutoff of -R and -o wdeg without one, every task below it restarts its own subtree
+#define RESTART_CUTOFF 8
 
-// Don't touch this
-volatile bool global_flag = false;
+// Seconds between two checkpoints unless -K gives them
+#define CHECKPOINT_SECONDS 60
 
 /**
  * @brief Prints the Sudoku board in a formatted manner.
@@ -57,148 +82,396 @@ void print_board(board_t *board_data, int sidelength) {
 }
 
 /**
- * @brief Initializes the bitmask arrays for a Sudoku board.
+ * @brief Initializes one of the bundled Sudoku boards based on the board size.
+ * 
+ * This function loads boards/board_NxN.dat through board_load(), initializes the board structure,
+ * and populates the unassigned array with the coordinates of unassigned cells (cells with value 0).
+ * 
+ * @param board_size The size of the Sudoku board, 25, 36 or 64.
+ * @param board Pointer to the board_t structure to be initialized.
+ * @param ua Pointer to the array of unassigned cells.
+ * 
+ * @return Returns 1 on successful initialization, or 0 if an error occurs.
+ * 
+ * @warning Ensure that the file paths and formats match the expected structure. The function
+ *          will return 0 and print an error message if the file is missing or corrupted.
+ */
+int board_init(int board_size, board_t *board, ua_t *ua) {
+    if(board_size != 25 && board_size != 36 && board_size != 64) {
+        printf("File not found\n");
+        return 0;
+    }
+    char path[32];
+    snprintf(path, sizeof(path), "boards/board_%dx%d.dat", board_size, board_size);
+    return board_load(path, 0, board, ua);
+}
+
+// Solutions counted by the calling thread and not yet added to their search, see solutions_flush()
+static struct {
+    search_t *search;
+    long count;
+} local_solutions;
+#pragma omp threadprivate(local_solutions)
+
+/**
+ * @brief Prepares the shared state of a search before its engine runs.
  *
- * This function sets up the bitmask arrays for rows, columns, and blocks respectively, based on the current state 
- * of the Sudoku board. Each bit in these arrays represents whether a number is present in the corresponding row, column, or block.
+ * @param search The search.
+ * @param quiet Verify the solution without printing it.
+ */
+void search_init(search_t *search, bool quiet) {
+    atomic_init(&search->found, false);
+    atomic_init(&search->published, false);
+    atomic_init(&search->exhausted, false);
+    atomic_init(&search->solutions, 0);
+    search->winner = NULL;
+    search->stop_nodes = 0;
+    search->valid = false;
+    search->quiet = quiet;
+}
+
+/**
+ * @brief Adds the solutions counted by the calling thread to the total of their search.
  *
- * @param board A pointer to the Sudoku board structure.
- * 
- * The function iterates through each cell of the Sudoku board. If the cell 
- * contains a non-zero value, it updates the corresponding bitmask arrays 
- * by setting the bit corresponding to the value in the appropriate row, column, and block.
+ * Counting a solution only increments a per-thread counter, this is the reduction. Every task
+ * of the engines calls it when it ends and run_engine() once the engine returns, so the total
+ * is complete when the engine returns. A thread that moves on to another search adds the
+ * count of the previous one first.
  *
- * Example:
- * - If the value at board->board[0][2] is 3, the function will set the 
- *   3rd bit in rbits[0], cbits[2], and the bitmask for the block 
- *   containing the cell. 
+ * @return The total of the search after the addition, 0 if the thread had nothing to add.
+ */
+long solutions_flush(void) {
+    long count = local_solutions.count;
+    if(count == 0) {
+        return 0;
+    }
+    local_solutions.count = 0;
+    return atomic_fetch_add_explicit(&local_solutions.search->solutions, count, memory_order_relaxed) + count;
+}
+
+/**
+ * @brief Writes the cells of a completed board into grid.
  *
- * @note The bitmask operations use 64-bit integers to represent the presence 
- *   of numbers in rows, columns, and blocks. This means that the max size of
- *   the Sudoku board is limited to 64x64.
+ * These are the cells the search started from, the values placed by the task levels above
+ * the board, and the cells propagated on the board itself, which are on the calling thread's
+ * trail. Every other cell holds a value of the sequential search, whose cells keep the values
+ * of branches it backtracked from as well but only where one of the others has the cell.
  */
-static inline void bitmask_init(board_t *board) {
-    unsigned char base = board->base;
-    unsigned char sidelength = board->sidelength;
-    for(int i = 0; i < sidelength; i++) {
-        for(int j = 0; j < sidelength; j++) {
-            unsigned char curr_val = board->board[i][j];
-            // Checking if the value is not 0, if it is not 0, update the bitmasks
-            if(curr_val != 0) {
-                int curr_block = (i / base) * base + (j / base);
-                board->rbits[i] |= ((int64_t)1 << curr_val);
-                board->cbits[j] |= ((int64_t)1 << curr_val);
-                board->bbits[curr_block] |= ((int64_t)1 << curr_val);
+static void board_cells(const board_t *board, unsigned char (*grid)[MAX_SIDELENGTH]) {
+    int sidelength = board->sidelength;
+    memcpy(grid, board->board, grid_bytes(sidelength));
+    if(board->cells != NULL) {
+        for(int i = 0; i < sidelength; i++) {
+            for(int j = 0; j < sidelength; j++) {
+                if(grid[i][j] == 0) {
+                    grid[i][j] = board->cells[i][j];
+                }
             }
         }
     }
+    for(const path_t *path = board->path; path != NULL; path = path->parent) {
+        for(int k = 0; k < path->n; k++) {
+            grid[path->cells[k].cell.x][path->cells[k].cell.y] = path->cells[k].value;
+        }
+    }
+    trail_fill(grid, board->trail_base);
 }
 
 /**
- * @brief Initializes the Sudoku board by reading data from a file based on the board size.
- * 
- * This function reads a pre-defined Sudoku board from a file, initializes the board structure,
- * and populates the unassigned array with the coordinates of unassigned cells (cells with value 0).
- * 
- * @param board_size The size of the Sudoku board.
- * @param board Pointer to the board_t structure to be initialized.
- * @param ua Pointer to the array of unassigned cells.
- * 
- * @return Returns 1 on successful initialization, or 0 if an error occurs.
- * 
- * @note The function also initializes bitmask arrays and calculates the number of unassigned cells.
- * 
- * @warning Ensure that the file paths and formats match the expected structure. The function
- *          will return 0 and print an error message if the file is missing or corrupted.
+ * @brief Counts a completed board as a solution of the search, see report_solution().
+ *
+ * Without a limit the count stays in the per-thread counter until solutions_flush(). With a
+ * limit every solution is added to the total right away, and the one that reaches the limit
+ * sets the found flag, which stops the search like a first solution does. The first solution
+ * counted is kept and verified, the others are only counted.
+ *
+ * @return true if this call reached the limit.
  */
-inline int board_init(int board_size, board_t *board, ua_t *ua) {
-    FILE *file = NULL;
-    if(board_size == 36){
-        file = fopen("boards/board_36x36.dat", "r");
+static bool count_solution(board_t *board) {
+    search_t *search = board->search;
+    if(local_solutions.search != search) {
+        solutions_flush();
+        local_solutions.search = search;
     }
-    if(board_size == 25){
-        file = fopen("boards/board_25x25.dat", "r");
+    local_solutions.count++;
+    bool reached = false;
+    if(board->opts->limit > 0 && solutions_flush() >= board->opts->limit) {
+        reached = !atomic_exchange_explicit(&search->found, true, memory_order_relaxed);
     }
-    if(board_size == 64){
-        file = fopen("boards/board_64x64.dat", "r");
+    if(!atomic_exchange_explicit(&search->published, true, memory_order_relaxed)) {
+        board_t solved = *board;
+        solved.board = search->solution;
+        board_cells(board, search->solution);
+        search->valid = verify(&solved);
     }
-    if(file == NULL) {
-        printf("File not found\n");
-        return 0;
+    return reached;
+}
+
+/**
+ * @brief Publishes a completed board as the solution of the search.
+ *
+ * The first caller claims the found flag of the board's search with a compare and swap, so
+ * every other board copy stops on its next node without a flush or a critical section. It
+ * then builds the cells in search->solution, see board_cells(), verifies them and prints them
+ * unless the search is quiet. Shared by all engines so a solution is always checked by the same
+ * verify() path, and the grid is only ever written here instead of in every task that led to it.
+ *
+ * When counting (opts->count) the board is counted by count_solution() instead and the
+ * search goes on, so the caller backtracks from the board unless this returns true.
+ *
+ * @param board A pointer to a board without empty cells.
+ * @return true if this call published the solution, false if another search got there first.
+ */
+bool report_solution(board_t *board) {
+    search_t *search = board->search;
+    if(board->opts->count) {
+        return count_solution(board);
     }
- 
-    unsigned char base = 0;
-    unsigned char sidelength = 0;
-    if(fread(&base, sizeof(unsigned char), 1, file) != 1) {
-        printf("Error reading base\n");
-        fclose(file);
-        return 0;
+    // Claim the search, exactly one caller wins and the other board copies see the flag on their next node
+    bool expected = false;
+    if(!atomic_compare_exchange_strong_explicit(&search->found, &expected, true, memory_order_acq_rel, memory_order_relaxed)) {
+        return false;
     }
-    if(fread(&sidelength, sizeof(unsigned char), 1, file) != 1) {
-        printf("Error reading side length\n");
-        fclose(file);
-        return 0;
+    // The winner is the only writer of the solution, readers wait for the engine to return
+    search->winner = board->opts;
+    board_t solved = *board;
+    solved.board = search->solution;
+    board_cells(board, search->solution);
+    search->valid = verify(&solved);
+    atomic_store_explicit(&search->published, true, memory_order_relaxed);
+    if(!search->quiet) {
+        if(search->valid)
+        {   
+            printf("\n");
+            printf("------------------------------------------------------\n");
+            print_board(&solved, board->sidelength);
+            printf("Valid solution\n");
+        }
+        else
+        {
+            printf("Invalid solution\n");
+        }
     }
-    
-    board->base = base;
-    board->sidelength = sidelength;
-    board->n_zeros = 0;
-    
-    memset(board->rbits, 0, sizeof(int64_t) * MAX_SIDELENGTH);
-    memset(board->cbits, 0, sizeof(int64_t) * MAX_SIDELENGTH);
-    memset(board->bbits, 0, sizeof(int64_t) * MAX_SIDELENGTH);
-    
-    int curr = 0;
-    // Place the values on the board
-    for(int i = 0; i < sidelength; i++) {
-        for(int j = 0; j < sidelength; j++) {
-            if(fread(&board->board[i][j], sizeof(unsigned char), 1, file) != 1) {
-                printf("Error reading board data\n");
-                fclose(file);
-                return 0;
-            }
-            // If the value is zero, its unassigned which means that we add it to the unassigned array.
-            if(board->board[i][j] == 0) {
-                board->n_zeros++;
-                ua[curr].x = i; 
-                ua[curr].y = j;
-                curr++;
-            }
+    return true;
+}
+
+/**
+ * @brief Body of a task spawned by solver(): places one value on a private copy of the masks and searches on.
+ *
+ * The task keeps no grid. The value and the cells propagated from it go to a path that
+ * links to the path of the spawning board, report_solution() puts the grid together from it.
+ *
+ * @param ua The array of unassigned cells.
+ * @param board The board of the spawning node, alive until its taskwait.
+ * @param task_board The private board of the task, with buffers attached.
+ * @param cell The cell the value goes in.
+ * @param value The value to place.
+ * @param zeroes The number of empty cells left before the value is placed.
+ * @param cutoff The threshold for switching between parallel and sequential execution.
+ */
+static void solve_branch(ua_t *ua, board_t *board, board_t *task_board, ua_t cell, int value, short int zeroes, int cutoff) {
+    // A task that starts after the search was won skips the copy
+    if(search_done(board->search)) {
+        return;
+    }
+    // Copy the bitmasks
+    double copy_start = stats_copy_begin();
+    board_copy(task_board, board);
+    stats_copy_end(copy_start);
+
+    // Place the value on the masks and propagate, both on the trail for now
+    int mark = trail_mark();
+    // Kept a call into another file, GCC 12 leaves the upper halves of the vector registers dirty
+    // after the copy of the board_t when the next call is to a function of this one, which makes
+    // the OpenMP runtime run the tasks at half speed
+    trail_place(task_board, cell.x, cell.y, value);
+    short int placed = 0;
+    bool consistent = !board->opts->propagate || propagate(task_board, ua, &placed);
+
+    // The child tasks may run on other threads, so the values move from the trail to the path
+    decision_t cells[trail_mark() - mark];
+    path_t path = {board->path, trail_save(mark, cells), cells};
+    task_board->path = &path;
+
+    // Recursive call, a solution is published by report_solution() so nothing is copied back
+    if(consistent) {
+        solver(ua, task_board, zeroes - 1 - placed, cutoff);
+    }
+}
+
+typedef bool (*sequential_fn_t)(ua_t *ua, board_t *board, short int zeroes);
+
+/**
+ * @brief Sequential backtracking below the task levels of solver(), for a board of the given base.
+ *
+ * Always inlined, once per base of SPECIALIZED_BASES with base a constant so that the block
+ * indexing and the candidate count loops fold to that base, and once more in the generic
+ * search with the base of the board. The recursion goes through self, the function it was
+ * inlined into, so every instantiation only ever calls itself.
+ *
+ * A search with a node budget (search->stop_nodes) that runs out sets search->exhausted, and
+ * the found flag to stop the other board copies like a solution does. A run of a
+ * restarting search (board->restart) that runs out only marks itself aborted, and every
+ * level undoes its cell on the way out, so the board is back at the root of the run. The
+ * values placed go to board->cells and stay there on backtrack, the masks tell which cells
+ * are filled and report_solution() only reads the cells of a completed board. Dead
+ * ends add to the conflict weights of the restarting search: the cell left without
+ * candidates, or the branching cell whose value propagation refuted.
+ *
+ * @param ua The array of unassigned cells.
+ * @param board The board, with board->cells set, its masks are updated in place and restored on backtrack.
+ * @param zeroes The number of empty cells left.
+ * @param base The base of the board.
+ * @param self The instantiation for base.
+ * @return true if a solution is found, false otherwise.
+ */
+static inline __attribute__((always_inline)) bool sequential_search(ua_t *ua, board_t *board, short int zeroes, const int base, sequential_fn_t self) {
+    if(search_done(board->search)) {
+        return false;
+    }
+    stats_node(board->n_zeros - zeroes);
+    if(zeroes == 0) {
+        return report_solution(board);
+    }
+    if(board->search->stop_nodes > 0 && stats_thread()->nodes >= board->search->stop_nodes) {
+        atomic_store_explicit(&board->search->exhausted, true, memory_order_relaxed);
+        atomic_store_explicit(&board->search->found, true, memory_order_relaxed);
+        return false;
+    }
+    if(board->restart != NULL && stats_thread()->nodes >= board->restart->stop_nodes) {
+        board->restart->aborted = true;
+        return false;
+    }
+    ua_t index = {0, 0};
+    if(!select_cell(ua, board, zeroes, &index)) {
+        if(board->restart != NULL) {
+            board->restart->weight[index.x][index.y]++;
+        }
+        return false;
+    }
+    int row = index.x;
+    int column = index.y;
+    for(uint64_t cand = candidates_base(board, base, row, column); cand != 0; ) {
+        int i = next_value(board, cand, row, column);
+        cand &= ~(uint64_t)VALUE_BIT(i);
+        board->cells[row][column] = i;
+        bit_update_base(board, base, row, column, i, true);
+
+        int mark = trail_mark();
+        short int placed = 0;
+        bool consistent = !board->opts->propagate || propagate(board, ua, &placed);
+
+        if(consistent && self(ua, board, zeroes - 1 - placed)) {
+            return true;
         }
+        if(!consistent && board->restart != NULL) {
+            board->restart->weight[row][column]++;
+        }
+
+        // Undo the propagated cells before the branching cell itself
+        trail_undo(board, mark);
+        bit_update_base(board, base, row, column, i, false);
+        stats_backtrack();
+    }
+    return false;
+}
+
+static bool sequential_generic(ua_t *ua, board_t *board, short int zeroes) {
+    return sequential_search(ua, board, zeroes, board->base, sequential_generic);
+}
+
+#define SEQUENTIAL_VARIANT(B) \
+static bool sequential_##B(ua_t *ua, board_t *board, short int zeroes) { \
+    return sequential_search(ua, board, zeroes, B, sequential_##B); \
+}
+SPECIALIZED_BASES(SEQUENTIAL_VARIANT)
+
+/**
+ * @brief Returns the sequential search for a base, the generic one if the base has no specialization.
+ */
+static sequential_fn_t sequential_variant(int base) {
+    switch(base) {
+        #define SEQUENTIAL_CASE(B) case B: return sequential_##B;
+        SPECIALIZED_BASES(SEQUENTIAL_CASE)
+        default: return sequential_generic;
     }
-    bitmask_init(board);
-    fclose(file); 
-    return 1;
 }
 
 /**
- * @brief Updates the bitmask representation of the Sudoku board for a specific cell.
+ * @brief Returns the node budget of a run of a restarting search.
  *
- * This function modifies the bitmasks associated with rows, columns, and blocks
- * in the Sudoku board to either add or remove a specific value. The bitmasks are
- * used to efficiently track which numbers are present in each row, column, and block.
+ * @param opts The options, with the policy and its unit.
+ * @param run The run, 0 for the first.
+ */
+static long restart_length(const solver_opts_t *opts, long run) {
+    if(opts->restarts == RESTART_GEOMETRIC) {
+        double length = opts->restart_nodes;
+        for(long r = 0; r < run && length < LONG_MAX / 4; r++) {
+            length *= RESTART_GROWTH;
+        }
+        return length < LONG_MAX / 4 ? (long)length : LONG_MAX / 4;
+    }
+    // Luby: find the smallest complete subsequence holding the run, then walk down into it
+    long size = 1;
+    int seq = 0;
+    while(size < run + 1) {
+        seq++;
+        size = 2 * size + 1;
+    }
+    while(size - 1 != run) {
+        size = (size - 1) >> 1;
+        seq--;
+        run = run % size;
+    }
+    return seq < 40 ? opts->restart_nodes << seq : LONG_MAX / 4;
+}
+
+/**
+ * @brief Sequential search of a subtree in runs, restarting each run from the root of the subtree.
  *
- * @param board Pointer to the Sudoku board structure.
- * @param row The row index of the cell to update.
- * @param column The column index of the cell to update.
- * @param value The value to add or remove from the bitmasks.
- * @param add A boolean flag indicating the operation to perform (true for add, false for remove).
+ * A run that exceeds its node budget, as the restart policy sets it, is abandoned and the
+ * subtree is searched again from scratch with the values of every cell in a random order
+ * drawn from a new seed, which also moves the start of the MRV scan. The conflict weights
+ * the runs gather persist from run to run, so with ORDER_WDEG later runs branch first on
+ * the cells that failed most. Without a policy, or when counting (a repeated run would count
+ * its solutions again), the subtree is searched once with the weights.
  *
+ * @param ua The array of unassigned cells.
+ * @param board The board, back in its state on return unless a solution was found.
+ * @param zeroes The number of empty cells left.
+ * @return true if a solution is found, false otherwise.
  */
-static inline void bit_update(board_t *board, int row, int column, int value, bool add) {
-    int curr_block = (row / board->base) * board->base + (column / board->base);
-    int64_t mask = ((int64_t)1 << value);
-    if(add) {
-        // Add the value to the bitmasks using the OR operator
-        board->rbits[row] |= mask;
-        board->cbits[column] |= mask;
-        board->bbits[curr_block] |= mask;
-    } else {
-        // Remove the value from the bitmasks using the NOT operator
-        board->rbits[row] &= ~mask;
-        board->cbits[column] &= ~mask;
-        board->bbits[curr_block] &= ~mask;
+static bool restart_search(ua_t *ua, board_t *board, short int zeroes) {
+    const solver_opts_t *opts = board->opts;
+    restart_t *restart = calloc(1, sizeof(restart_t));
+    if(restart == NULL) {
+        printf("Error allocating restart state\n");
+        return sequential_variant(board->base)(ua, board, zeroes);
     }
+    bool restarting = opts->restarts != RESTART_NONE && !opts->count;
+    solver_opts_t run_opts = *opts;
+    board->opts = &run_opts;
+    board->restart = restart;
+    bool solved = false;
+    for(long run = 0; ; run++) {
+        restart->aborted = false;
+        restart->stop_nodes = restarting ? stats_thread()->nodes + restart_length(opts, run) : LONG_MAX;
+        solved = sequential_variant(board->base)(ua, board, zeroes);
+        if(solved || !restart->aborted || search_done(board->search)) {
+            break;
+        }
+        stats_restart();
+        run_opts.values = VALUES_RANDOM;
+        run_opts.seed = mix64(opts->seed + run + 1);
+    }
+    // The solution was published with the options of the run, hand back the caller's
+    if(solved && board->search->winner == &run_opts) {
+        board->search->winner = opts;
+    }
+    board->opts = opts;
+    board->restart = NULL;
+    free(restart);
+    return solved;
 }
 
 /**
@@ -206,8 +479,9 @@ static inline void bit_update(board_t *board, int row, int column, int value, bo
  *
  * Attempts to solve a Sudoku puzzle represented by the given board.
  * It uses OpenMP tasks for parallel execution when the number of remaining zeroes
- * exceeds a specified cutoff. The function updates the board in place and verifies
- * the solution upon completion.
+ * exceeds a specified cutoff. Below the cutoff the search for the base of the board takes over,
+ * see sequential_search(). The solution is published and verified by report_solution(),
+ * run_engine() copies it back to the root board.
  *
  * @param ua An array of coordinates (ua_t) representing the positions of zeroes in the board.
  * @param board A pointer to the Sudoku board structure (board_t) containing the puzzle state.
@@ -215,250 +489,643 @@ static inline void bit_update(board_t *board, int row, int column, int value, bo
  * @param cutoff The threshold for switching between parallel and sequential execution.
  * @return true if a solution is found, false otherwise.
  *
- * @note Memory allocation for board copies can be configured to use either heap or stack, depending on the HEAP_ALLOCATION macro.
+ * @note Board copies for tasks come either from the per-thread slab pool or from the stack, depending on the HEAP_ALLOCATION macro.
  * 
  */
 bool solver(ua_t *ua, board_t *board, short int zeroes, int cutoff) {
-    // Check if someone found the solution, flush so we read the actual value from memory instead of private cache
-    #pragma omp flush(global_flag)
-    if(global_flag) {
+    // The values of the task levels are on the path, whatever is propagated from here on goes on the trail
+    board->trail_base = trail_mark();
+    // Check if we are at the parallel cutoff, begin serial execution if thats the case 
+    if(zeroes <= board->n_zeros - cutoff) {
+        stats_search_begin();
+        // Cells of the sequential search, never cleared, so nothing is copied into them
+        unsigned char cells[board->sidelength][MAX_SIDELENGTH];
+        board->cells = cells;
+        int mark = trail_mark();
+        bool solved = board->opts->restarts != RESTART_NONE || board->opts->order == ORDER_WDEG
+                      ? restart_search(ua, board, zeroes) : sequential_variant(board->base)(ua, board, zeroes);
+        // A search that stops leaves its board filled, drop what it propagated from the trail
+        trail_undo(NULL, mark);
+        board->cells = NULL;
+        stats_search_end();
+        return solved;
+    }
+    // Check if someone found the solution
+    if(search_done(board->search)) {
         return false;
     }
+    stats_node(board->n_zeros - zeroes);
     if(zeroes == 0) {
-        // No zeroes left, set global to true and verify the solution
-        #pragma omp critical
-        {
-            #pragma omp flush(global_flag)
-            if (!global_flag) {
-                global_flag = true;
-                if(verify(*board))
-                {   
-                    #if PERFORMANCE
-
-                    #else
-                    printf("\n");
-                    printf("------------------------------------------------------\n");
-                    print_board(board, board->sidelength);
-                    printf("Valid solution\n");
-
-                    #endif
-                }
-                else
-                {
-                    printf("Invalid solution\n");
-                }
-                
-            }
-        }
-        return true;
+        // No zeroes left, publish and verify the solution
+        return report_solution(board);
     }
-    // Find the current zero index
-    ua_t index = ua[zeroes-1];
-    int row = index.x;
-    int column = index.y;
-    // Check if we are at the parallel cutoff, begin serial execution if thats the case 
-    bool task_level = zeroes > (board->n_zeros-cutoff);
-    if(task_level) {
-        for(int i = 1; i <= board->sidelength; i++) {
-            // Find the current subgrid and create the mask 
-            int curr_block = (row / board->base) * board->base + (column / board->base);
-            int64_t mask = ((int64_t)1 << i);
-            // Check that the value is not already in the row, column or block
-            if(!((board->rbits[row] & mask) || (board->cbits[column] & mask) || (board->bbits[curr_block] & mask))) {
-                // Placement is valid, create a task with a board copy
-                #pragma omp task firstprivate(i, zeroes)
-                {
-                    // Dynamically allocate memory if HEAP_ALLOCATION is set to 1 
-                    #if HEAP_ALLOCATION
-                    board_t task_board;
-                    unsigned char (*task_board_array)[MAX_SIDELENGTH] = malloc(sizeof(unsigned char) * MAX_SIDELENGTH * MAX_SIDELENGTH);
-                    int64_t *task_rbits = malloc(sizeof(int64_t) * MAX_SIDELENGTH);
-                    int64_t *task_cbits = malloc(sizeof(int64_t) * MAX_SIDELENGTH);
-                    int64_t *task_bbits = malloc(sizeof(int64_t) * MAX_SIDELENGTH);
-                    #else
-                    // Allocated on the stack
-                    board_t task_board;
-                    unsigned char task_board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
-                    int64_t task_rbits[MAX_SIDELENGTH];
-                    int64_t task_cbits[MAX_SIDELENGTH];
-                    int64_t task_bbits[MAX_SIDELENGTH];
-                    #endif
-                    
-                    // Copy the board and the bitmasks
-                    memcpy(&task_board, board, sizeof(board_t));
-                    task_board.board = task_board_array;
-                    task_board.rbits = task_rbits;
-                    task_board.cbits = task_cbits;
-                    task_board.bbits = task_bbits;
-                    memcpy(task_board_array, board->board, sizeof(unsigned char) * MAX_SIDELENGTH * MAX_SIDELENGTH);
-                    memcpy(task_rbits, board->rbits, sizeof(int64_t) * MAX_SIDELENGTH);
-                    memcpy(task_cbits, board->cbits, sizeof(int64_t) * MAX_SIDELENGTH);
-                    memcpy(task_bbits, board->bbits, sizeof(int64_t) * MAX_SIDELENGTH);
-
-                    // Place the value on the board and then update the bitmask 
-                    task_board.board[row][column] = i;
-                    bit_update(&task_board, row, column, i, true);
-                    
-                    // Recursive call 
-                    if(solver(ua, &task_board, zeroes - 1, cutoff)) {
-                        memcpy(board->board, task_board.board, sizeof(unsigned char) * MAX_SIDELENGTH * MAX_SIDELENGTH);
-                        memcpy(board->rbits, task_board.rbits, sizeof(int64_t) * MAX_SIDELENGTH);
-                        memcpy(board->cbits, task_board.cbits, sizeof(int64_t) * MAX_SIDELENGTH);
-                        memcpy(board->bbits, task_board.bbits, sizeof(int64_t) * MAX_SIDELENGTH);                        
-                    }
-                    
-                    #if HEAP_ALLOCATION
-                    // Free the allocated copy
-                    free(task_board_array);
-                    free(task_rbits);
-                    free(task_cbits);
-                    free(task_bbits);
-                    #endif
-                } 
-            }
-        }
-        
-        #pragma omp taskwait
+    // Find the cell to branch on, a dead end shows up as a cell without candidates
+    ua_t index = {0, 0};
+    if(!select_cell(ua, board, zeroes, &index)) {
         return false;
     }
-    // Sequential execution, same stuff but without the annoying copying
-    else {
-        for(int i = 1; i <= board->sidelength; i++) {
-
-            int curr_block = (row / board->base) * board->base + (column / board->base);
-            int64_t mask = ((int64_t)1 << i);
-            if(!((board->rbits[row] & mask) || (board->cbits[column] & mask) || (board->bbits[curr_block] & mask))) {
-                board->board[row][column] = i;
-                bit_update(board, row, column, i, true);
-                
-                if(solver(ua, board, zeroes - 1, cutoff)) {
-                    return true;
-                }
-                
-                board->board[row][column] = 0;
-                bit_update(board, row, column, i, false);
+    // Values not yet in the row, column or block, visited in the value order of the options
+    uint64_t cand = candidates(board, index.x, index.y);
+    while(cand != 0 && !search_done(board->search)) {
+        int i = next_value(board, cand, index.x, index.y);
+        cand &= ~(uint64_t)VALUE_BIT(i);
+        // Create a task, it copies the masks when it starts
+        stats_task_spawned();
+        #pragma omp task firstprivate(i, zeroes)
+        {
+            stats_task_executed();
+            // Buffers are sized to the board, only the used masks and rows of counts are allocated
+            int sidelength = board->sidelength;
+            board_t task_board;
+            memcpy(&task_board, board, sizeof(board_t));
+            #if HEAP_ALLOCATION
+            // Slab from this thread's pool, no malloc once the pool is warm
+            bool allocated = pool_attach(&task_board, sidelength, board->count != NULL);
+            #else
+            // Allocated on the stack
+            int64_t task_rbits[sidelength];
+            int64_t task_cbits[sidelength];
+            int64_t task_bbits[sidelength];
+            int64_t task_filled[sidelength];
+            unsigned char task_count_array[board->count != NULL ? sidelength : 1][MAX_SIDELENGTH];
+            unsigned char task_tally[board->count != NULL ? sidelength : 1][MAX_SIDELENGTH + 1];
+            uint64_t task_tally_rows[sidelength + 1];
+            task_board.rbits = task_rbits;
+            task_board.cbits = task_cbits;
+            task_board.bbits = task_bbits;
+            task_board.filled = board->filled != NULL ? task_filled : NULL;
+            task_board.count = board->count != NULL ? task_count_array : NULL;
+            task_board.tally = board->count != NULL ? task_tally : NULL;
+            task_board.tally_rows = board->count != NULL ? task_tally_rows : NULL;
+            bool allocated = true;
+            #endif
+
+            if(allocated) {
+                solve_branch(ua, board, &task_board, index, i, zeroes, cutoff);
+            } else {
+                printf("Error allocating task board\n");
             }
-        }
-        return false;
+            solutions_flush();
+            
+            #if HEAP_ALLOCATION
+            // Give the slab back to this thread's pool
+            if(allocated) {
+                pool_detach(&task_board);
+            }
+            #endif
+        } 
     }
-}
 
+    #pragma omp taskwait
+    return false;
+}
 
-int main(int argc, char *argv[]) {
-    if(argc != 4) {
-        printf("Usage: %s <board_size> <threads> <cutoff>\n", argv[0]);
-        printf("board_size: 25, 36, 64\n");
-        printf("Recommended cutoff for board sizes: 25x25 - any, 36x36 - 5, 64x64 - 100 (max 500)\n");
-        return 1;
+/**
+ * @brief Runs the propagation pass on a freshly loaded board if it is enabled.
+ *
+ * @param board Pointer to the board filled by board_init().
+ * @param ua The array of unassigned cells built by board_init().
+ *
+ * @return The number of empty cells left for solver(), or -1 if the puzzle has no solution.
+ */
+short int load_propagate(board_t *board, ua_t *ua) {
+    if(!board->opts->propagate) {
+        return board->n_zeros;
     }
+    short int placed = 0;
+    int mark = trail_mark();
+    bool consistent = propagate(board, ua, &placed);
+    // The root board is never backtracked past this point, the cells become part of its grid
+    trail_fill(board->board, mark);
+    trail_undo(NULL, mark);
+    return consistent ? board->n_zeros - placed : -1;
+}
 
+/**
+ * @brief Runs the engine selected in the options on a loaded board.
+ *
+ * Has to be called from a single thread inside a parallel region, every engine spawns tasks.
+ * When a solution was published its cells are copied to the board once the engine returns,
+ * when counting the first solution counted is. A search that ran out of its node budget
+ * publishes none.
+ */
+void run_engine(ua_t *ua, board_t *board, short int zeroes, int cutoff) {
+    board->trail_base = trail_mark();
+    if(board->opts->engine == ENGINE_DLX) {
+        dlx_solver(ua, board, zeroes);
+    } else if(board->opts->scheduler == SCHED_STEAL) {
+        steal_solver(ua, board, zeroes);
+    } else {
+        solver(ua, board, zeroes, cutoff);
+    }
+    solutions_flush();
+    // Every task is done, hand the published solution to the root board
+    if(atomic_load_explicit(&board->search->published, memory_order_relaxed)) {
+        memcpy(board->board, board->search->solution, grid_bytes(board->sidelength));
+    }
+}
 
-    #if PERFORMANCE
-    int size_array[3] = {25, 36, 64};
-    int thread_array[6] = {1, 2, 4, 6, 8, 12};
-    int cutoff_array[9] = {1, 5, 10, 20, 30, 40, 50, 70, 100};
-    for(int i = 0; i < 3; i++){
-        int board_size = size_array[i];
-        if(board_size == 64) {
-            cutoff_array[0] = 50;
-            cutoff_array[1] = 75;
-            cutoff_array[2] = 100;
-            cutoff_array[3] = 150;
-            cutoff_array[4] = 200;
-            cutoff_array[5] = 250;
-            cutoff_array[6] = 300;
-            cutoff_array[7] = 400;
-            cutoff_array[8] = 500;
-        }
-        for(int j = 0; j < 6; j++){
-            int nthreads = thread_array[j];
-            for(int k = 0; k < 9; k++){
-                int cutoff = cutoff_array[k];
-                double avg_time = 0;
-                for(int m = 0; m < 5; m++){
-                    board_t board;
-                    ua_t ua[MAX_CELLS];
-                    unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
-                    int64_t rbits[MAX_SIDELENGTH];
-                    int64_t cbits[MAX_SIDELENGTH];
-                    int64_t bbits[MAX_SIDELENGTH];
-                    
-            
-                    board.board = (unsigned char (*)[MAX_SIDELENGTH])board_array;
-                    board.rbits = rbits;
-                    board.cbits = cbits;
-                    board.bbits = bbits;
-            
-                    if (!board_init(board_size, &board, ua)) {
-                        printf("Error initializing board\n");
+// The benchmark links this file without its main, see bench.c
+#ifndef SOLVER_NO_MAIN
+int main(int argc, char *argv[]) {
+    solver_opts_t opts = { .engine = ENGINE_BITMASK, .scheduler = SCHED_STEAL, .order = ORDER_FIXED, .propagate = false, .split_nodes = 0,
+                           .restart_nodes = RESTART_NODES, .checkpoint_seconds = CHECKPOINT_SECONDS };
+    char *batch_path = NULL;
+    char *verify_path = NULL;
+    char *kernel = "auto";
+    char *stats_path = NULL;
+    char *pack_path = NULL;
+    char *serve_path = NULL;
+    char *resume_path = NULL;
+    char *worker_address = NULL;
+    int local_workers = 0;
+    int coordinator_port = 0;
+    bool distributed = false;
+    long cache_size = SERVICE_CACHE;
+    long index = 0;
+    bool unique = false;
+    int members = 0;
+    affinity_t affinity = AFFINITY_NONE;
+    int opt;
+    while((opt = getopt(argc, argv, "a:A:b:C:D:e:i:j:k:K:l:n:o:pr:R:s:S:uv:W:X:")) != -1) {
+        switch(opt) {
+            case 'a':
+                pack_path = optarg;
+                break;
+            case 'A':
+                if(!affinity_parse(optarg, &affinity)) {
+                    printf("Invalid thread placement: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'b':
+                batch_path = optarg;
+                break;
+            case 'C':
+                cache_size = atol(optarg);
+                if(cache_size < 1) {
+                    printf("Invalid cache size: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'D': {
+                // local[:port]
+                char *port = strchr(optarg, ':');
+                local_workers = atoi(optarg);
+                coordinator_port = port != NULL ? atoi(port + 1) : 0;
+                if(local_workers < 0 || (port != NULL && (coordinator_port < 1 || coordinator_port > 65535))
+                   || (local_workers == 0 && coordinator_port == 0)) {
+                    printf("Invalid distribution: %s\n", optarg);
+                    return 1;
+                }
+                distributed = true;
+                break;
+            }
+            case 'e':
+                if(strcmp(optarg, "bitmask") == 0) {
+                    opts.engine = ENGINE_BITMASK;
+                } else if(strcmp(optarg, "dlx") == 0) {
+                    opts.engine = ENGINE_DLX;
+                } else {
+                    printf("Invalid engine: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                index = atol(optarg);
+                if(index < 0) {
+                    printf("Invalid board index: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'j':
+                stats_path = optarg;
+                break;
+            case 'k':
+                kernel = optarg;
+                break;
+            case 'K': {
+                // file[:seconds]
+                char *interval = strrchr(optarg, ':');
+                if(interval != NULL) {
+                    *interval = '\0';
+                    opts.checkpoint_seconds = atof(interval + 1);
+                    if(opts.checkpoint_seconds <= 0) {
+                        printf("Invalid checkpoint interval: %s\n", interval + 1);
                         return 1;
                     }
-                    double time1 = omp_get_wtime();
-                    global_flag = false;
-                    #pragma omp parallel num_threads(nthreads)
-                    {   
-                        #pragma omp single nowait
-                        {
-                            solver(ua, &board, board.n_zeros, cutoff);
-                        }
+                }
+                opts.checkpoint = optarg;
+                break;
+            }
+            case 'l':
+                if(strcmp(optarg, "low") == 0) {
+                    opts.values = VALUES_LOW;
+                } else if(strcmp(optarg, "high") == 0) {
+                    opts.values = VALUES_HIGH;
+                } else if(strcmp(optarg, "random") == 0) {
+                    opts.values = VALUES_RANDOM;
+                } else {
+                    printf("Invalid value order: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'n':
+                opts.count = true;
+                opts.limit = atol(optarg);
+                if(opts.limit < 0) {
+                    printf("Invalid solution limit: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'p':
+                opts.propagate = true;
+                break;
+            case 'r':
+                members = atoi(optarg);
+                if(members < 1 || members > MAX_MEMBERS) {
+                    printf("Invalid number of portfolio members: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'R': {
+                // policy[:nodes]
+                char *unit = strchr(optarg, ':');
+                size_t length = unit != NULL ? (size_t)(unit - optarg) : strlen(optarg);
+                if(strncmp(optarg, "none", length) == 0 && length == 4) {
+                    opts.restarts = RESTART_NONE;
+                } else if(strncmp(optarg, "luby", length) == 0 && length == 4) {
+                    opts.restarts = RESTART_LUBY;
+                } else if(strncmp(optarg, "geometric", length) == 0 && length == 9) {
+                    opts.restarts = RESTART_GEOMETRIC;
+                } else {
+                    printf("Invalid restart policy: %s\n", optarg);
+                    return 1;
+                }
+                if(unit != NULL) {
+                    opts.restart_nodes = atol(unit + 1);
+                    if(opts.restart_nodes < 1) {
+                        printf("Invalid restart length: %s\n", unit + 1);
+                        return 1;
                     }
-                    double time2 = omp_get_wtime() - time1;
-                    avg_time += time2;
                 }
-                avg_time = avg_time / 5;
-                printf("Board size: %d, Threads: %d, Cutoff: %d, Avg Time: %f\n", board_size, nthreads, cutoff, avg_time);
+                break;
             }
+            case 's':
+                opts.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'S':
+                serve_path = optarg;
+                break;
+            case 'u':
+                unique = true;
+                break;
+            case 'v':
+                verify_path = optarg;
+                break;
+            case 'W':
+                worker_address = optarg;
+                break;
+            case 'X':
+                resume_path = optarg;
+                break;
+            case 'o':
+                if(strcmp(optarg, "fixed") == 0) {
+                    opts.order = ORDER_FIXED;
+                } else if(strcmp(optarg, "mrv") == 0) {
+                    opts.order = ORDER_MRV;
+                } else if(strcmp(optarg, "wdeg") == 0) {
+                    opts.order = ORDER_WDEG;
+                } else {
+                    printf("Invalid cell order: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                return 1;
         }
     }
+    if(unique) {
+        // Two solutions are enough to tell that the puzzle is not unique
+        opts.count = true;
+        opts.limit = 2;
+    }
+    if(serve_path != NULL && (opts.count || members > 0 || batch_path != NULL)) {
+        printf("The service answers with the first solution of every puzzle\n");
+        return 1;
+    }
+    if((opts.checkpoint != NULL || resume_path != NULL) && (members > 0 || batch_path != NULL || serve_path != NULL)) {
+        printf("Checkpoints are written and resumed for the search of a single board\n");
+        return 1;
+    }
+    if(distributed && (worker_address != NULL || members > 0 || batch_path != NULL || serve_path != NULL || verify_path != NULL
+                       || opts.checkpoint != NULL || resume_path != NULL || affinity != AFFINITY_NONE)) {
+        // The workers are forked before any thread team exists, see distrib.c
+        printf("Distributed search runs on a single board, without -A, -r, -K or -X\n");
+        return 1;
+    }
+    if(worker_address != NULL && (members > 0 || batch_path != NULL || serve_path != NULL || verify_path != NULL
+                                  || opts.checkpoint != NULL || resume_path != NULL || opts.count)) {
+        printf("A worker searches the board its coordinator sends, without -n, -u, -r, -K or -X\n");
+        return 1;
+    }
+    if(members > 0 && (opts.count || batch_path != NULL)) {
+        printf("Portfolio mode races for the first solution of a single board\n");
+        return 1;
+    }
+    if(!kernel_select(kernel)) {
+        printf("Unsupported kernel: %s\n", kernel);
+        return 1;
+    }
+    if(pack_path != NULL) {
+        if(argc - optind != 1) {
+            printf("Usage: %s -a <container> <file|->\n", argv[0]);
+            return 1;
+        }
+        source_t source;
+        if(!source_open(&source, argv[optind])) {
+            return 1;
+        }
+        FILE *out = strcmp(pack_path, "-") == 0 ? stdout : fopen(pack_path, "wb");
+        if(out == NULL) {
+            printf("Could not open %s\n", pack_path);
+            source_close(&source);
+            return 1;
+        }
+        int count = container_write(&source, out);
+        if(out != stdout) {
+            fclose(out);
+        }
+        source_close(&source);
+        if(count < 0) {
+            printf("Error writing %s\n", pack_path);
+            return 1;
+        }
+        fprintf(stderr, "Packed %d boards into %s\n", count, pack_path);
+        return 0;
+    }
+    // A batch, a file of solutions or the coordinator of a worker takes the place of the board
+    bool from_file = batch_path != NULL || verify_path != NULL || serve_path != NULL || worker_address != NULL;
+    int n_args = argc - optind + from_file;
+    if(n_args != 2 && n_args != 3) {
+        printf("Usage: %s [-e bitmask|dlx] [-o fixed|mrv|wdeg] [-l low|high|random] [-s <seed>] [-R <policy>[:nodes]] [-p] [-k auto|avx512|avx2|scalar] [-A none|close|spread] [-n <limit>|-u|-r <members>] [-K <file>[:seconds]] [-X <file>] [-D <workers>[:port]] [-j <file|->] [-i <index>] <board> <threads> [cutoff]\n", argv[0]);
+        printf("       %s [-e bitmask|dlx] [-o fixed|mrv|wdeg] [-l low|high|random] [-s <seed>] [-R <policy>[:nodes]] [-p] [-k auto|avx512|avx2|scalar] [-A none|close|spread] [-n <limit>|-u] [-i <index>] -b <file|-> <threads> [cutoff]\n", argv[0]);
+        printf("       %s [-e bitmask|dlx] [-o fixed|mrv|wdeg] [-l low|high|random] [-s <seed>] [-R <policy>[:nodes]] [-p] [-k auto|avx512|avx2|scalar] [-A none|close|spread] [-C <entries>] -S <socket|-> <threads> [cutoff]\n", argv[0]);
+        printf("       %s [-e bitmask|dlx] [-o fixed|mrv|wdeg] [-l low|high|random] [-s <seed>] [-R <policy>[:nodes]] [-p] [-k auto|avx512|avx2|scalar] [-A none|close|spread] -W <host>:<port> <threads> [cutoff]\n", argv[0]);
+        printf("       %s -v <file|-> <threads>\n", argv[0]);
+        printf("       %s -a <container> <file|->\n", argv[0]);
+        printf("board: 25, 36, 64 for the bundled boards, or a .dat, text or container file (- for stdin)\n");
+        printf("cutoff: spawn a task per candidate in the first cutoff levels (max 500) instead of work stealing\n");
+        printf("-e: engine, bitmask (backtracking, default) or dlx (exact cover with Dancing Links)\n");
+        printf("-o: cell order, fixed (file order, default), mrv (fewest candidates first) or wdeg (fewest per conflict weight below the cutoff)\n");
+        printf("-R: restart the sequential search below the cutoff (default %d with -R or -o wdeg), none (default), luby or geometric runs of nodes (default %d) each\n", RESTART_CUTOFF, RESTART_NODES);
+        printf("-l: value order of the bitmask engine, low (default), high or random (drawn per cell from the seed)\n");
+        printf("-s: seed of -l random and of the MRV tie-breaking, 0 (default) breaks ties by file order\n");
+        printf("-r: race members differently configured searches on the board, one per thread at most, the first solution wins\n");
+        printf("-p: fill naked and hidden singles on load and after every placement\n");
+        printf("-k: candidate kernel used by -p, auto (widest the CPU supports, default), avx512, avx2 or scalar\n");
+        printf("-A: pin the threads, none (default), close (filling one NUMA node first) or spread (round robin over the nodes)\n");
+        printf("-K: write the open subtrees of the work-stealing search to a file every seconds (default %d), and on SIGTERM or SIGINT before stopping\n", CHECKPOINT_SECONDS);
+        printf("-X: resume the search of the board from a checkpoint written by -K, on any number of threads\n");
+        printf("-D: split the board into subproblems for workers, forked locally and accepted over TCP on port, the first solution stops them all\n");
+        printf("-W: search subproblems for the coordinator at host:port, with the threads and options given here\n");
+        printf("-n: count the solutions instead of stopping at the first one, stopping after limit of them (0 counts all)\n");
+        printf("-u: check that the solution is unique, same as -n 2, exits with 1 if it is not\n");
+        printf("-j: write the per-thread search counters of the run as JSON to a file or stdout\n");
+        printf("-i: load board index of the file (0 for the first), with -b the first board to solve\n");
+        printf("-b: solve every board of a file (or stdin) in any board format, one result line per board\n");
+        printf("-S: serve board lines from a Unix socket (or stdin), one result line each, on a team kept for the whole run\n");
+        printf("-C: results the cache of the service keeps by canonical form (default %d)\n", SERVICE_CACHE);
+        printf("-v: check every board of a file (or stdin) of back to back .dat solutions, one valid/invalid line per board\n");
+        printf("-a: pack every board of a file (or stdin) into an indexed container for random access with -i\n");
+        return 1;
+    }
+    bool has_cutoff = n_args == 3;
+    argv += optind - 1 - from_file;
+
+
+    search_t search;
+    search_init(&search, opts.count);
 
-    #else 
 
-    int board_size = atoi(argv[1]);
     int nthreads = atoi(argv[2]);
-    int cutoff = atoi(argv[3]);
+    int cutoff = has_cutoff ? atoi(argv[3]) : 0;
 
     if(nthreads < 1) {
         printf("Invalid number of threads\n");
         return 1;
     }
 
-    if(cutoff < 1 || cutoff > 500) {
-        printf("Invalid cutoff\n");
+    if(has_cutoff) {
+        if(cutoff < 1 || cutoff > 500) {
+            printf("Invalid cutoff\n");
+            return 1;
+        }
+        opts.scheduler = SCHED_CUTOFF;
+    } else if(opts.restarts != RESTART_NONE || opts.order == ORDER_WDEG) {
+        // Restarts and weights live in the sequential search below the cutoff of solver()
+        cutoff = RESTART_CUTOFF;
+        opts.scheduler = SCHED_CUTOFF;
+    }
+
+    if((opts.checkpoint != NULL || resume_path != NULL) && (opts.scheduler != SCHED_STEAL || opts.engine != ENGINE_BITMASK)) {
+        printf("Checkpoints need the work-stealing bitmask search, without a cutoff, -R or -o wdeg\n");
         return 1;
     }
 
+    if(affinity != AFFINITY_NONE) {
+        // The threads keep their CPU for every later region of the same size
+        omp_set_dynamic(0);
+        affinity_apply(affinity, nthreads, 0);
+    }
+
+    if(worker_address != NULL) {
+        int status = distrib_work(worker_address, &opts, nthreads, cutoff);
+        #if HEAP_ALLOCATION
+        pool_release();
+        #endif
+        return status ? 0 : 1;
+    }
+
+    if(verify_path != NULL) {
+        FILE *file = strcmp(verify_path, "-") == 0 ? stdin : fopen(verify_path, "rb");
+        if(file == NULL) {
+            printf("File not found\n");
+            return 1;
+        }
+        int status = verify_batch(file, nthreads);
+        if(file != stdin) {
+            fclose(file);
+        }
+        return status ? 0 : 1;
+    }
+
+    if(serve_path != NULL) {
+        int status = service_run(strcmp(serve_path, "-") == 0 ? NULL : serve_path, &opts, nthreads, cutoff, cache_size);
+        #if HEAP_ALLOCATION
+        pool_release();
+        #endif
+        return status ? 0 : 1;
+    }
+
+    if(batch_path != NULL) {
+        source_t source;
+        if(!source_open(&source, batch_path)) {
+            return 1;
+        }
+        if(index > 0 && !source_seek(&source, index)) {
+            printf("No board %ld in %s\n", index, batch_path);
+            source_close(&source);
+            return 1;
+        }
+        int status = batch_run(&source, &opts, nthreads, cutoff);
+        source_close(&source);
+        #if HEAP_ALLOCATION
+        pool_release();
+        #endif
+        return status ? 0 : 1;
+    }
+
+    // The sizes of the bundled boards, anything else is a path
+    char *board_name = argv[1];
+    bool bundled = strcmp(board_name, "25") == 0 || strcmp(board_name, "36") == 0 || strcmp(board_name, "64") == 0;
     board_t board;
     ua_t ua[MAX_CELLS];
     unsigned char board_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
     int64_t rbits[MAX_SIDELENGTH];
     int64_t cbits[MAX_SIDELENGTH];
     int64_t bbits[MAX_SIDELENGTH];
+    int64_t filled[MAX_SIDELENGTH];
+    unsigned char count_array[MAX_SIDELENGTH][MAX_SIDELENGTH];
+    unsigned char tally_array[MAX_SIDELENGTH][MAX_SIDELENGTH + 1];
+    uint64_t tally_rows[MAX_SIDELENGTH + 1];
     
 
     board.board = (unsigned char (*)[MAX_SIDELENGTH])board_array;
     board.rbits = rbits;
     board.cbits = cbits;
     board.bbits = bbits;
+    board.filled = tracks_filled(&opts) ? filled : NULL;
+    board.count = opts.order != ORDER_FIXED ? count_array : NULL;
+    board.tally = board.count != NULL ? tally_array : NULL;
+    board.tally_rows = board.count != NULL ? tally_rows : NULL;
+    board.opts = &opts;
+    board.search = &search;
 
-    if (!board_init(board_size, &board, ua)) {
+    if (!(bundled ? board_init(atoi(board_name), &board, ua) : board_load(board_name, index, &board, ua))) {
         printf("Error initializing board\n");
         return 1;
     }
     
+    // The search counters are threadprivate and are read back by a team of the same size
+    omp_set_dynamic(0);
     double time = omp_get_wtime();
     print_board(&board, board.sidelength);
-    #pragma omp parallel num_threads(nthreads) 
-    {
-        #pragma omp single nowait
+    short int zeroes = load_propagate(&board, ua);
+    int winner = -1;
+    frontier_t frontier;
+    if(zeroes > 0 && resume_path != NULL) {
+        if(!checkpoint_read(resume_path, &board, &frontier)) {
+            return 1;
+        }
+        printf("Resuming %ld open subtrees from %s\n", frontier.count, resume_path);
+        opts.resume = &frontier;
+    }
+    if(opts.checkpoint != NULL) {
+        // The search writes one last checkpoint and stops
+        signal(SIGTERM, steal_interrupt);
+        signal(SIGINT, steal_interrupt);
+    }
+    if(zeroes < 0) {
+        printf("No solution\n");
+    } else if(distributed) {
+        if(!distrib_coordinate(&board, ua, zeroes, local_workers, coordinator_port, nthreads, cutoff)) {
+            return 1;
+        }
+    } else {
+        #pragma omp parallel num_threads(nthreads) 
         {
-            solver(ua, &board, board.n_zeros, cutoff);
+            #pragma omp single nowait
+            {
+                if(members > 0) {
+                    winner = portfolio_solver(ua, &board, zeroes, members, cutoff);
+                } else {
+                    run_engine(ua, &board, zeroes, cutoff);
+                }
+            }
         }
     }
     
     time = omp_get_wtime() - time;
 
-    printf("Board: %d Nthreads: %d recursion-cutoff: %d time taken: %f seconds \n", board_size, nthreads, cutoff, time);
-    
-#endif
-    return 0;
-}
\ No newline at end of file
+    long solutions = zeroes >= 0 ? atomic_load(&search.solutions) : 0;
+    if(opts.count) {
+        if(opts.limit > 0 && solutions >= opts.limit) {
+            printf("Solutions: at least %ld (limit)\n", solutions);
+        } else {
+            printf("Solutions: %ld\n", solutions);
+        }
+        if(solutions > 0 && !search.valid) {
+            printf("Invalid solution\n");
+        }
+        if(unique) {
+            printf("Unique: %s\n", solutions == 1 ? "yes" : "no");
+        }
+    }
+
+    if(winner >= 0) {
+        solver_opts_t member;
+        portfolio_member(&opts, winner, &member);
+        static const char *order_names[] = {"fixed", "mrv", "wdeg"};
+        static const char *value_names[] = {"low", "high", "random"};
+        printf("Portfolio: won by member %d (%s cell order, %s values, seed %llu)\n", winner,
+               order_names[member.order], value_names[member.values], (unsigned long long)member.seed);
+    }
+
+    if(distributed) {
+        printf("Board: %s Nthreads: %d distributed over %d local workers time taken: %f seconds \n", board_name, nthreads, local_workers, time);
+    } else if(members > 0) {
+        printf("Board: %s Nthreads: %d portfolio of %d time taken: %f seconds \n", board_name, nthreads, members, time);
+    } else if(opts.engine == ENGINE_DLX) {
+        // Dancing Links runs its own tasks, neither the cutoff nor the scheduler applies
+        printf("Board: %s Nthreads: %d dancing-links time taken: %f seconds \n", board_name, nthreads, time);
+    } else if(opts.scheduler == SCHED_CUTOFF) {
+        printf("Board: %s Nthreads: %d recursion-cutoff: %d time taken: %f seconds \n", board_name, nthreads, cutoff, time);
+    } else {
+        printf("Board: %s Nthreads: %d work-stealing time taken: %f seconds \n", board_name, nthreads, time);
+    }
+
+    if(opts.restarts != RESTART_NONE) {
+        printf("Restarts: %ld\n", stats_restarts(nthreads));
+    }
+
+    if(opts.checkpoint != NULL) {
+        printf("Checkpoints: %ld written to %s\n", steal_checkpoints(), opts.checkpoint);
+    }
+    if(steal_interrupted()) {
+        printf("Interrupted, resume with -X %s\n", opts.checkpoint);
+        return 1;
+    }
+
+    #if SEARCH_STATS
+    stats_report(stdout, nthreads, false);
+    #endif
+    if(stats_path != NULL) {
+        FILE *file = strcmp(stats_path, "-") == 0 ? stdout : fopen(stats_path, "w");
+        if(file == NULL) {
+            printf("Could not open %s\n", stats_path);
+            return 1;
+        }
+        stats_report(file, nthreads, true);
+        if(file != stdout) {
+            fclose(file);
+        }
+    }
+
+    #if HEAP_ALLOCATION
+    pool_report();
+    pool_release();
+    #endif
+    return unique && solutions != 1 ? 1 : 0;
+}
+#endif
\ No newline at end of file
@@ -1,24 +1,133 @@
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
 #pragma once
 #define MAX_SIDELENGTH 64
 
+// Bit used for a value in the row, column and block masks (values 1..64 map to bits 0..63)
+#define VALUE_BIT(value) ((int64_t)((uint64_t)1 << ((value) - 1)))
+
+// Bit used for a column in the masks of the filled cells of a row
+#define COLUMN_BIT(column) ((int64_t)((uint64_t)1 << (column)))
+
+// Bit used for a row in the masks of the rows holding empty cells of a candidate count
+#define ROW_BIT(row) ((uint64_t)1 << (row))
+
+typedef enum {
+    ORDER_FIXED,    // Branch on ua[zeroes-1], the reverse file order of the empty cells
+    ORDER_MRV,      // Branch on the empty cell with the fewest remaining candidates
+    ORDER_WDEG      // Fewest candidates per conflict weight (dom/wdeg), MRV where the search keeps no weights
+} cell_order_t;
+
+typedef enum {
+    RESTART_NONE,       // Backtrack chronologically through the whole subtree
+    RESTART_LUBY,       // Runs of restart_nodes times the Luby sequence 1, 1, 2, 1, 1, 2, 4, ...
+    RESTART_GEOMETRIC   // Runs of restart_nodes growing by RESTART_GROWTH each restart
+} restart_policy_t;
+
+typedef enum {
+    VALUES_LOW,     // Lowest candidate value first
+    VALUES_HIGH,    // Highest candidate value first
+    VALUES_RANDOM   // Ascending from a value drawn per cell from the seed, wrapping around
+} value_order_t;
+
+typedef enum {
+    ENGINE_BITMASK, // Backtracking over the row, column and block bitmasks in solver()
+    ENGINE_DLX      // Exact cover with Dancing Links in dlx_solver()
+} engine_t;
+
+typedef enum {
+    SCHED_CUTOFF,   // One task per candidate in the first cutoff levels of solver()
+    SCHED_STEAL     // Idle threads take over part of a busy thread's search, see steal.c
+} scheduler_t;
+
+typedef struct {
+    engine_t engine;
+    scheduler_t scheduler;
+    cell_order_t order;
+    value_order_t values;   // Bitmask engine: order the candidates of a cell are tried in
+    uint64_t seed;          // Draws of VALUES_RANDOM, and where ORDER_MRV starts its scan of ua so that ties break differently
+    bool propagate;     // Fill naked and hidden singles after every placement
+    long split_nodes;   // Work stealing: nodes searched by one thread before the rest of the team joins
+    bool count;         // Count the solutions instead of stopping at the first one
+    long limit;         // Counting: stop once this many solutions are found, 0 counts them all
+    restart_policy_t restarts;  // Sequential search below the cutoff: when to give up on a run and start over
+    long restart_nodes;         // Nodes of the first run, the unit the policy scales
+    const char *checkpoint;     // Work stealing: file the open subtrees are written to, NULL for none
+    double checkpoint_seconds;  // Work stealing: time between two checkpoints
+    struct frontier_s *resume;  // Work stealing: subtrees of an earlier run to search instead of the whole board, NULL for none
+} solver_opts_t;
+
+// State shared by every board copy of one search
+typedef struct {
+    atomic_bool found;      // Claimed by the first search that completes the board, or set when a count reaches its limit; stops the others
+    bool valid;             // Whether the published solution passed verify()
+    bool quiet;             // Verify the solution without printing it
+    atomic_bool published;  // Set with the solution kept in solution, when counting claimed by the first one counted
+    atomic_bool exhausted;  // Set when a sequential search ran out of stop_nodes, along with found to stop the others
+    atomic_long solutions;  // Counting: solutions added by solutions_flush()
+    const solver_opts_t *winner;    // Options of the board that published the solution
+    long stop_nodes;        // Sequential searches give up once the node counter of their thread reaches this, 0 never
+    unsigned char solution[MAX_SIDELENGTH][MAX_SIDELENGTH];    // Cells of the published solution
+} search_t;
+
+// State of one restarting sequential search, see restart_search() in solver.c
+typedef struct {
+    long stop_nodes;    // Node counter of the thread at which the current run gives up
+    bool aborted;       // The current run gave up before exhausting its subtree
+    unsigned int weight[MAX_SIDELENGTH][MAX_SIDELENGTH];   // Conflicts of every cell, kept across runs
+} restart_t;
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+} ua_t;
+
+typedef struct {
+    ua_t cell;
+    unsigned char value;
+} decision_t;
+
+// Values placed by one task level of solver(), linked to those of the levels above it
+typedef struct path_s {
+    const struct path_s *parent;
+    int n;
+    const decision_t *cells;
+} path_t;
+
 typedef struct {
     unsigned char base;
     unsigned char sidelength;
     short int n_zeros;
-    unsigned char (*board)[MAX_SIDELENGTH];
+    unsigned char (*board)[MAX_SIDELENGTH];    // Cells the search started from, shared by every board of the search, see board_cells() in solver.c
+    unsigned char (*cells)[MAX_SIDELENGTH];    // Values placed by the sequential search of the board, left behind on backtrack, NULL if none runs
     int64_t *rbits;
     int64_t *cbits;
     int64_t *bbits;
+    int64_t *filled;        // Filled cells of every row, COLUMN_BIT() of the column, NULL if the search never reads them, see tracks_filled()
+    unsigned char (*count)[MAX_SIDELENGTH];
+    unsigned char (*tally)[MAX_SIDELENGTH + 1];    // Empty cells of every row by candidate count, set with count, see select_cell()
+    uint64_t *tally_rows;   // Rows with empty cells of every candidate count, ROW_BIT() of the row
+    const solver_opts_t *opts;
+    search_t *search;
+    restart_t *restart;     // Set while a restarting sequential search runs on the board, NULL otherwise
+    const path_t *path;     // Values placed by the task levels above the board, NULL at the root
+    int trail_base;         // Position of the thread's trail from which the cells propagated on the board start
 
 } board_t;
 
-typedef struct {
-    unsigned char x; 
-    unsigned char y; 
-} ua_t; 
-
 
 int board_init(int board_size, board_t *board, ua_t *ua);
 
-bool solver(ua_t *ua, board_t *board, short int zeroes, int cutoff);
\ No newline at end of file
+short int load_propagate(board_t *board, ua_t *ua);
+
+void run_engine(ua_t *ua, board_t *board, short int zeroes, int cutoff);
+
+bool solver(ua_t *ua, board_t *board, short int zeroes, int cutoff);
+
+void search_init(search_t *search, bool quiet);
+
+bool report_solution(board_t *board);
+
+long solutions_flush(void);
@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <omp.h>
+#include "solver.h"
+#include "stats.h"
+
+thread_stats_t local_stats;
+
+/**
+ * @brief Clears the counters of every thread of a team of nthreads threads.
+ *
+ * Must be called outside of a parallel region, with the team size the search will use.
+ */
+void stats_reset(int nthreads) {
+    #pragma omp parallel num_threads(nthreads)
+    memset(&local_stats, 0, sizeof(thread_stats_t));
+}
+
+/**
+ * @brief Returns the nodes counted by a team of nthreads threads since the last stats_reset().
+ */
+long stats_nodes(int nthreads) {
+    long nodes = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:nodes)
+    nodes += local_stats.nodes;
+    return nodes;
+}
+
+/**
+ * @brief Returns the restarts counted by a team of nthreads threads since the last stats_reset().
+ */
+long stats_restarts(int nthreads) {
+    long restarts = 0;
+    #pragma omp parallel num_threads(nthreads) reduction(+:restarts)
+    restarts += local_stats.restarts;
+    return restarts;
+}
+
+/**
+ * @brief Prints the counters of a team of nthreads threads and the load imbalance of the team.
+ *
+ * The imbalance is the largest node count of a thread divided by the mean over the team, 1.0
+ * when every thread searched the same number of nodes.
+ *
+ * @param file The stream to print to.
+ * @param nthreads The number of threads of the team, as used by the search.
+ * @param json Print a JSON object instead of a table.
+ */
+void stats_report(FILE *file, int nthreads, bool json) {
+    thread_stats_t team[nthreads];
+    memset(team, 0, sizeof(thread_stats_t) * nthreads);
+    #pragma omp parallel num_threads(nthreads)
+    team[omp_get_thread_num()] = local_stats;
+
+    long total = 0;
+    long most = 0;
+    long restarts = 0;
+    for(int t = 0; t < nthreads; t++) {
+        total += team[t].nodes;
+        restarts += team[t].restarts;
+        if(team[t].nodes > most) {
+            most = team[t].nodes;
+        }
+    }
+    double imbalance = total > 0 ? (double)most * nthreads / total : 1.0;
+
+    if(json) {
+        fprintf(file, "{\"threads\": %d, \"nodes\": %ld, \"restarts\": %ld, \"imbalance\": %.3f, \"per_thread\": [",
+                nthreads, total, restarts, imbalance);
+        for(int t = 0; t < nthreads; t++) {
+            thread_stats_t *stats = &team[t];
+            fprintf(file, "%s\n  {\"thread\": %d, \"nodes\": %ld, \"restarts\": %ld", t == 0 ? "" : ",", t, stats->nodes,
+                    stats->restarts);
+#if SEARCH_STATS
+            fprintf(file, ", \"backtracks\": %ld, \"tasks_spawned\": %ld, \"tasks_executed\": %ld, \"max_depth\": %d, "
+                    "\"copy_s\": %.6f, \"search_s\": %.6f", stats->backtracks, stats->tasks_spawned,
+                    stats->tasks_executed, stats->max_depth, stats->copy_time, stats->search_time);
+#endif
+            fprintf(file, "}");
+        }
+        fprintf(file, "\n]}\n");
+        return;
+    }
+
+#if SEARCH_STATS
+    fprintf(file, "%6s %12s %8s %12s %8s %8s %6s %10s %10s\n", "thread", "nodes", "restarts", "backtracks", "spawned",
+            "executed", "depth", "copy_ms", "search_ms");
+#else
+    fprintf(file, "%6s %12s %8s\n", "thread", "nodes", "restarts");
+#endif
+    for(int t = 0; t < nthreads; t++) {
+        thread_stats_t *stats = &team[t];
+#if SEARCH_STATS
+        fprintf(file, "%6d %12ld %8ld %12ld %8ld %8ld %6d %10.3f %10.3f\n", t, stats->nodes, stats->restarts,
+                stats->backtracks, stats->tasks_spawned, stats->tasks_executed, stats->max_depth,
+                stats->copy_time * 1e3, stats->search_time * 1e3);
+#else
+        fprintf(file, "%6d %12ld %8ld\n", t, stats->nodes, stats->restarts);
+#endif
+    }
+    fprintf(file, "Nodes: %ld restarts: %ld imbalance: %.3f\n", total, restarts, imbalance);
+}
@@ -0,0 +1,137 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <omp.h>
+#include "solver.h"
+#pragma once
+
+// Build with make STATS=1 to count backtracks, tasks, depth and copy/search time per thread
+#ifndef SEARCH_STATS
+#define SEARCH_STATS 0
+#endif
+
+/*
+ * Per-thread search counters, kept threadprivate so counting a node is a plain increment of
+ * thread local storage. The node count is always kept, it is what the benchmark reports, and
+ * so are the restart count, which only moves once per restart of a search, and the propagation
+ * passes, which the generator grades by; the rest only exists in a SEARCH_STATS build and every helper below compiles to nothing otherwise.
+ * Threadprivate values persist between parallel regions of the same size when dynamic
+ * adjustment of the team size is off, which is how stats_reset() and the collecting
+ * functions reach the counters of the team that ran the search.
+ */
+typedef struct {
+    long nodes;                 // Values tried
+    long restarts;              // Runs of a restarting search given up, see restart_search()
+    long passes;                // Naked and hidden singles passes of propagate()
+#if SEARCH_STATS
+    long backtracks;            // Values taken back after their subtree failed
+    long tasks_spawned;
+    long tasks_executed;
+    int max_depth;              // Most cells filled on a board of the search
+    int searching;              // Nesting of stats_search_begin(), only the outermost call is timed
+    double search_start;
+    double search_time;         // Seconds in sequential search
+    double copy_time;           // Seconds copying and replaying boards for tasks and work items
+#endif
+} thread_stats_t;
+
+extern thread_stats_t local_stats;
+#pragma omp threadprivate(local_stats)
+
+/**
+ * @brief Returns the counters of the calling thread.
+ */
+static inline thread_stats_t *stats_thread(void) {
+    return &local_stats;
+}
+
+/**
+ * @brief Counts a node with the number of cells filled on its board.
+ */
+static inline void stats_node(int depth) {
+    thread_stats_t *stats = stats_thread();
+    stats->nodes++;
+#if SEARCH_STATS
+    if(depth > stats->max_depth) {
+        stats->max_depth = depth;
+    }
+#else
+    (void)depth;
+#endif
+}
+
+static inline void stats_restart(void) {
+    stats_thread()->restarts++;
+}
+
+static inline void stats_pass(void) {
+    stats_thread()->passes++;
+}
+
+static inline void stats_backtrack(void) {
+#if SEARCH_STATS
+    stats_thread()->backtracks++;
+#endif
+}
+
+static inline void stats_task_spawned(void) {
+#if SEARCH_STATS
+    stats_thread()->tasks_spawned++;
+#endif
+}
+
+static inline void stats_task_executed(void) {
+#if SEARCH_STATS
+    stats_thread()->tasks_executed++;
+#endif
+}
+
+/**
+ * @brief Returns the start time of a copy for stats_copy_end(), 0 when the stats are compiled out.
+ */
+static inline double stats_copy_begin(void) {
+#if SEARCH_STATS
+    return omp_get_wtime();
+#else
+    return 0;
+#endif
+}
+
+static inline void stats_copy_end(double start) {
+#if SEARCH_STATS
+    stats_thread()->copy_time += omp_get_wtime() - start;
+#else
+    (void)start;
+#endif
+}
+
+/**
+ * @brief Marks the start of a sequential search, calls may nest and only the outermost is timed.
+ *
+ * The sequential search never reaches a task scheduling point, so the nesting is per thread.
+ */
+static inline void stats_search_begin(void) {
+#if SEARCH_STATS
+    thread_stats_t *stats = stats_thread();
+    if(stats->searching++ == 0) {
+        stats->search_start = omp_get_wtime();
+    }
+#endif
+}
+
+static inline void stats_search_end(void) {
+#if SEARCH_STATS
+    thread_stats_t *stats = stats_thread();
+    if(--stats->searching == 0) {
+        stats->search_time += omp_get_wtime() - stats->search_start;
+    }
+#endif
+}
+
+void stats_reset(int nthreads);
+
+long stats_nodes(int nthreads);
+
+long stats_restarts(int nthreads);
+
+void stats_report(FILE *file, int nthreads, bool json);
@@ -0,0 +1,609 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sched.h>
+#include <signal.h>
+#include <omp.h>
+#include "solver.h"
+#include "board.h"
+#include "propagate.h"
+#include "steal.h"
+#include "stats.h"
+#include "affinity.h"
+#include "checkpoint.h"
+
+// Nodes a thread searches between two looks at the checkpoint clock
+#define CHECKPOINT_POLL 16384
+
+// Added to hungry while a checkpoint waits, so every busy thread takes the donation branch
+#define CHECKPOINT_HUNGRY (1 << 24)
+
+/*
+ * Work-stealing scheduler for the bitmask engine.
+ *
+ * Every thread runs a depth-first search with an explicit stack of frames on its own board.
+ * A thread that runs out of work announces itself in `hungry`, and busy threads check that
+ * counter once per node. When it is set, the busy thread splits the untried values of its
+ * shallowest open frame, which is the largest subtree it still owns, and pushes them to the
+ * shared pool as a work item. Only the owner ever touches its stack, so the search itself
+ * needs no locks, and no depth cutoff has to be tuned per board size.
+ *
+ * The pool keeps one list per NUMA node. An item goes to the list of the node of the thread
+ * that split it off, and a hungry thread takes from the list of its own node before it looks
+ * at the others, so work crosses between sockets only when a node has run dry. Without
+ * pinned threads (affinity.c) every thread is on node 0 and there is a single list.
+ *
+ * With opts->checkpoint set, the threads look at the clock every CHECKPOINT_POLL nodes. Once
+ * a checkpoint is due, every busy thread puts all of its open frames back in the pool as work
+ * items and goes hungry; the last one to stop writes the pool to the file (checkpoint.c) and
+ * the search goes on from it. A search resumed from a file (opts->resume) starts with those
+ * items in the pool instead of the root cell. SIGTERM and SIGINT, when steal_interrupt() is
+ * their handler, ask for one last checkpoint after which the search stops.
+ *
+ * The calling thread starts out alone. The rest of the team is brought in as helper tasks
+ * right away, or once the search has gone past opts->split_nodes nodes, so easy boards in a
+ * batch never pay for the team.
+ */
+
+typedef struct {
+    ua_t cell;
+    unsigned char value;    // Value currently placed in cell, 0 if none
+    short int zeroes;       // Empty cells left before a value is placed in cell
+    int mark;               // Trail position right after the value was placed
+    uint64_t remaining;     // Values not tried yet
+} frame_t;
+
+struct steal_s;
+
+typedef bool (*search_fn_t)(struct steal_s *st, board_t *board, frame_t *frames, decision_t *base, work_t *item, short int zeroes, long split_nodes);
+
+// State of one work-stealing search, shared by its threads
+typedef struct steal_s {
+    ua_t *ua;
+    board_t *root;
+    short int root_zeroes;
+    omp_lock_t lock;
+    work_t *pool[MAX_NODES];    // Items by the node of the thread that gave them away
+    int pool_size;              // Items in all lists
+    int active;             // Threads holding a work item, only changed under lock
+    int hungry;             // Threads waiting for work
+    int helpers;            // Helper tasks to spawn once the split point is reached
+    search_fn_t search;     // Depth-first search for the base of the board, see search_variant()
+    double next_checkpoint; // omp_get_wtime() at which the next checkpoint is due
+    int checkpointing;      // A checkpoint waits for the busy threads to give back their frames
+    int interrupted;        // The last checkpoint was written and the search stops
+} steal_t;
+
+static volatile sig_atomic_t interrupt_requested = 0;
+static long checkpoints_written = 0;
+
+static void worker(steal_t *st, long split_nodes);
+
+/**
+ * @brief Pushes a work item to the list of the calling thread's node.
+ */
+static void push_work(steal_t *st, work_t *item) {
+    int node = affinity_node();
+    omp_set_lock(&st->lock);
+    item->next = st->pool[node];
+    st->pool[node] = item;
+    __atomic_store_n(&st->pool_size, st->pool_size + 1, __ATOMIC_RELAXED);
+    omp_unset_lock(&st->lock);
+}
+
+/**
+ * @brief Writes the pool to the checkpoint file once every thread gave back its frames, called under the lock.
+ */
+static void write_checkpoint(steal_t *st) {
+    board_t *root = st->root;
+    if(!search_done(root->search)) {
+        long solutions = atomic_load_explicit(&root->search->solutions, memory_order_relaxed);
+        if(checkpoint_write(root->opts->checkpoint, root, st->pool, MAX_NODES, solutions)) {
+            checkpoints_written++;
+        }
+    }
+    if(interrupt_requested) {
+        __atomic_store_n(&st->interrupted, 1, __ATOMIC_RELAXED);
+    }
+    double due = omp_get_wtime() + root->opts->checkpoint_seconds;
+    __atomic_store(&st->next_checkpoint, &due, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->checkpointing, 0, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&st->hungry, CHECKPOINT_HUNGRY, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Asks for a checkpoint if one is due, called by busy threads every CHECKPOINT_POLL nodes.
+ */
+static void poll_checkpoint(steal_t *st) {
+    double due;
+    __atomic_load(&st->next_checkpoint, &due, __ATOMIC_RELAXED);
+    if(!interrupt_requested && omp_get_wtime() < due) {
+        return;
+    }
+    int expected = 0;
+    if(__atomic_compare_exchange_n(&st->checkpointing, &expected, 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&st->hungry, CHECKPOINT_HUNGRY, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Waits until a work item is available in the pool, taken from the calling thread's node if it has one.
+ *
+ * @return The item, or NULL when the search is over: either a solution was found, or the
+ *         pool is empty and no thread holds work that could still be split.
+ */
+static work_t *take_work(steal_t *st) {
+    __atomic_add_fetch(&st->hungry, 1, __ATOMIC_RELAXED);
+    work_t *item = NULL;
+    int home = affinity_node();
+    while(!search_done(st->root->search) && !__atomic_load_n(&st->interrupted, __ATOMIC_RELAXED)) {
+        omp_set_lock(&st->lock);
+        if(__atomic_load_n(&st->checkpointing, __ATOMIC_RELAXED)) {
+            // Nothing is handed out until every busy thread gave back its frames
+            bool stopped = st->active == 0;
+            if(stopped) {
+                write_checkpoint(st);
+            }
+            omp_unset_lock(&st->lock);
+            if(!stopped) {
+                sched_yield();
+            }
+            continue;
+        }
+        int node = home;
+        for(int k = 1; k < MAX_NODES && st->pool[node] == NULL; k++) {
+            node = (home + k) % MAX_NODES;
+        }
+        if(st->pool[node] != NULL) {
+            item = st->pool[node];
+            st->pool[node] = item->next;
+            __atomic_store_n(&st->pool_size, st->pool_size - 1, __ATOMIC_RELAXED);
+            st->active++;
+            omp_unset_lock(&st->lock);
+            break;
+        }
+        bool done = st->active == 0;
+        omp_unset_lock(&st->lock);
+        if(done) {
+            break;
+        }
+        sched_yield();
+    }
+    __atomic_sub_fetch(&st->hungry, 1, __ATOMIC_RELAXED);
+    return item;
+}
+
+/**
+ * @brief Marks the work item held by the calling thread as finished.
+ */
+static void finish_work(steal_t *st) {
+    omp_set_lock(&st->lock);
+    st->active--;
+    omp_unset_lock(&st->lock);
+}
+
+/**
+ * @brief Gives every open frame of the calling thread to the pool, for a checkpoint.
+ *
+ * The value placed in the top frame has been searched, the values placed in the frames below
+ * it are covered by the frames above them, so the untried values of all frames are exactly
+ * what the thread has left to search.
+ */
+static void shelve(steal_t *st, frame_t *frames, int depth, decision_t *base, int base_depth) {
+    for(int i = 0; i <= depth; i++) {
+        if(frames[i].remaining == 0) {
+            continue;
+        }
+        work_t *item = malloc(sizeof(work_t) + sizeof(decision_t) * (base_depth + i));
+        if(item == NULL) {
+            printf("Error allocating work item\n");
+            return;
+        }
+        item->cell = frames[i].cell;
+        item->remaining = frames[i].remaining;
+        item->depth = base_depth + i;
+        memcpy(item->path, base, sizeof(decision_t) * base_depth);
+        for(int k = 0; k < i; k++) {
+            item->path[base_depth + k].cell = frames[k].cell;
+            item->path[base_depth + k].value = frames[k].value;
+        }
+        push_work(st, item);
+    }
+}
+
+/**
+ * @brief Gives part of the shallowest open frame to the pool.
+ *
+ * With two or more untried values the upper half of them is given away, otherwise the
+ * single value is, unless the frame is the top one. The item's path is the thread's own base path followed by the values
+ * currently placed in the frames above the split one.
+ *
+ * @param st The search.
+ * @param frames The stack of the calling thread.
+ * @param depth Index of the top frame.
+ * @param base The decisions leading to frames[0].
+ * @param base_depth The number of decisions in base.
+ * @return true if a checkpoint is waiting and the whole stack went to the pool instead, the thread then stops searching.
+ */
+static bool donate(steal_t *st, frame_t *frames, int depth, decision_t *base, int base_depth) {
+    if(__atomic_load_n(&st->checkpointing, __ATOMIC_RELAXED)) {
+        shelve(st, frames, depth, base, base_depth);
+        return true;
+    }
+    int i = 0;
+    while(i <= depth && frames[i].remaining == 0) {
+        i++;
+    }
+    uint64_t give = i <= depth ? frames[i].remaining : 0;
+    int n = __builtin_popcountll(give);
+    // The top frame is only split, giving all of it away would leave the thread without work
+    // and lets two threads pass the same value back and forth without ever searching it
+    if(n == 0 || (i == depth && n < 2)) {
+        return false;
+    }
+    for(int k = 0; k < n / 2; k++) {
+        give &= give - 1;
+    }
+    work_t *item = malloc(sizeof(work_t) + sizeof(decision_t) * (base_depth + i));
+    if(item == NULL) {
+        return false;
+    }
+    frames[i].remaining &= ~give;
+    item->cell = frames[i].cell;
+    item->remaining = give;
+    item->depth = base_depth + i;
+    memcpy(item->path, base, sizeof(decision_t) * base_depth);
+    for(int k = 0; k < i; k++) {
+        item->path[base_depth + k].cell = frames[k].cell;
+        item->path[base_depth + k].value = frames[k].value;
+    }
+    push_work(st, item);
+    return false;
+}
+
+/**
+ * @brief Rebuilds the board of a work item from the root board.
+ *
+ * The decisions are placed first and propagated once at the end, which reaches the same
+ * state as propagating after each of them since naked and hidden singles only ever add cells.
+ * Only the masks and the cells of the decisions are written, the propagated cells stay on the
+ * trail for report_solution() until the worker is done with the item.
+ *
+ * @return The number of empty cells left, or -1 if the item turned out to be inconsistent.
+ */
+static short int replay(steal_t *st, board_t *board, work_t *item) {
+    board_copy(board, st->root);
+    for(int k = 0; k < item->depth; k++) {
+        decision_t d = item->path[k];
+        board->cells[d.cell.x][d.cell.y] = d.value;
+        bit_update(board, d.cell.x, d.cell.y, d.value, true);
+    }
+    short int placed = 0;
+    if(board->opts->propagate && !propagate(board, st->ua, &placed)) {
+        return -1;
+    }
+    return st->root_zeroes - item->depth - placed;
+}
+
+/**
+ * @brief Spawns the helper tasks of the search, once.
+ */
+static void spawn_helpers(steal_t *st) {
+    int helpers = st->helpers;
+    st->helpers = 0;
+    for(int t = 0; t < helpers; t++) {
+        stats_task_spawned();
+        #pragma omp task
+        {
+            stats_task_executed();
+            worker(st, 0);
+        }
+    }
+}
+
+/**
+ * @brief Returns the nodes a search goes before it spawns the helpers or looks at the checkpoint clock.
+ *
+ * One countdown serves both, so a search without either pays a single decrement per node.
+ *
+ * @param split_nodes Nodes to search before spawning the helpers, 0 if they were spawned or are not this thread's.
+ * @param nodes Nodes searched so far.
+ * @param checkpoints Whether the search writes checkpoints.
+ * @return The nodes to go, -1 if neither is ever due.
+ */
+static long next_look(long split_nodes, long nodes, bool checkpoints) {
+    long step = checkpoints ? CHECKPOINT_POLL : -1;
+    if(split_nodes > 0 && (step < 0 || split_nodes - nodes < step)) {
+        step = split_nodes - nodes;
+    }
+    return step;
+}
+
+/**
+ * @brief Depth-first search of one work item on the thread's board.
+ *
+ * Always inlined, once per base of SPECIALIZED_BASES with board_base a constant and once in
+ * the generic search with the base of the board, see search_variant().
+ *
+ * @param st The search.
+ * @param board The board of the calling thread, rebuilt for the item by replay().
+ * @param frames The stack of the calling thread.
+ * @param base Buffer for the decisions leading to the item.
+ * @param item The work item.
+ * @param zeroes The number of empty cells on the board.
+ * @param split_nodes Nodes to search before spawning the helpers, 0 if this thread does not spawn them.
+ * @param board_base The base of the board.
+ * @return true if this thread published the solution, or reached the limit when counting.
+ */
+static inline __attribute__((always_inline)) bool search(steal_t *st, board_t *board, frame_t *frames, decision_t *base, work_t *item, short int zeroes, long split_nodes, const int board_base) {
+    ua_t *ua = st->ua;
+    int depth = 0;
+    int base_depth = item->depth;
+    bool checkpoints = board->opts->checkpoint != NULL;
+    long nodes = 0;
+    long step = next_look(split_nodes, nodes, checkpoints);
+    long countdown = step;
+    memcpy(base, item->path, sizeof(decision_t) * base_depth);
+    frames[0].cell = item->cell;
+    frames[0].value = 0;
+    frames[0].zeroes = zeroes;
+    frames[0].remaining = item->remaining;
+
+    while(depth >= 0) {
+        if(search_done(board->search)) {
+            return false;
+        }
+        if(--countdown == 0) {
+            nodes += step;
+            if(nodes == split_nodes) {
+                spawn_helpers(st);
+                split_nodes = 0;
+            }
+            if(checkpoints) {
+                poll_checkpoint(st);
+            }
+            step = next_look(split_nodes, nodes, checkpoints);
+            countdown = step;
+        }
+        if(__atomic_load_n(&st->hungry, __ATOMIC_RELAXED) > __atomic_load_n(&st->pool_size, __ATOMIC_RELAXED)) {
+            if(donate(st, frames, depth, base, base_depth)) {
+                return false;
+            }
+        }
+        frame_t *f = &frames[depth];
+        int row = f->cell.x;
+        int column = f->cell.y;
+        // Take back the previous value of the frame and everything propagated from it
+        if(f->value != 0) {
+            trail_undo(board, f->mark);
+            bit_update_base(board, board_base, row, column, f->value, false);
+            f->value = 0;
+            stats_backtrack();
+        }
+        if(f->remaining == 0) {
+            depth--;
+            continue;
+        }
+        int value = next_value(board, f->remaining, row, column);
+        f->remaining &= ~(uint64_t)VALUE_BIT(value);
+        f->value = value;
+        stats_node(st->root->n_zeros - f->zeroes);
+        board->cells[row][column] = value;
+        bit_update_base(board, board_base, row, column, value, true);
+        f->mark = trail_mark();
+
+        short int placed = 0;
+        if(board->opts->propagate && !propagate(board, ua, &placed)) {
+            continue;
+        }
+        short int left = f->zeroes - 1 - placed;
+        if(left == 0) {
+            // When counting the search goes on with the next value until the limit is reached
+            if(report_solution(board)) {
+                return true;
+            }
+            continue;
+        }
+        ua_t next;
+        if(!select_cell(ua, board, left, &next)) {
+            continue;
+        }
+        depth++;
+        frames[depth].cell = next;
+        frames[depth].value = 0;
+        frames[depth].zeroes = left;
+        frames[depth].remaining = candidates_base(board, board_base, next.x, next.y);
+    }
+    return false;
+}
+
+static bool search_generic(steal_t *st, board_t *board, frame_t *frames, decision_t *base, work_t *item, short int zeroes, long split_nodes) {
+    return search(st, board, frames, base, item, zeroes, split_nodes, board->base);
+}
+
+#define SEARCH_VARIANT(B) \
+static bool search_##B(steal_t *st, board_t *board, frame_t *frames, decision_t *base, work_t *item, short int zeroes, long split_nodes) { \
+    return search(st, board, frames, base, item, zeroes, split_nodes, B); \
+}
+SPECIALIZED_BASES(SEARCH_VARIANT)
+
+/**
+ * @brief Returns the search for a base, the generic one if the base has no specialization.
+ */
+static search_fn_t search_variant(int base) {
+    switch(base) {
+        #define SEARCH_CASE(B) case B: return search_##B;
+        SPECIALIZED_BASES(SEARCH_CASE)
+        default: return search_generic;
+    }
+}
+
+/**
+ * @brief Work loop of one thread, runs until the pool is exhausted or a solution is found.
+ *
+ * @param st The search.
+ * @param split_nodes Nodes to search before spawning the helpers, 0 if this thread does not spawn them.
+ */
+static void worker(steal_t *st, long split_nodes) {
+    board_t *root = st->root;
+    board_t board = *root;
+    unsigned char (*cells)[MAX_SIDELENGTH] = malloc(sizeof(unsigned char) * MAX_SIDELENGTH * MAX_SIDELENGTH);
+    int64_t *bits = malloc(sizeof(int64_t) * MAX_SIDELENGTH * 4);
+    unsigned char (*count)[MAX_SIDELENGTH] = NULL;
+    unsigned char (*tally)[MAX_SIDELENGTH + 1] = NULL;
+    uint64_t *tally_rows = NULL;
+    if(root->count != NULL) {
+        count = malloc(sizeof(unsigned char) * MAX_SIDELENGTH * MAX_SIDELENGTH);
+        tally = malloc(sizeof(unsigned char) * MAX_SIDELENGTH * (MAX_SIDELENGTH + 1));
+        tally_rows = malloc(sizeof(uint64_t) * (MAX_SIDELENGTH + 1));
+    }
+    frame_t *frames = malloc(sizeof(frame_t) * (root->n_zeros + 1));
+    decision_t *base = malloc(sizeof(decision_t) * (root->n_zeros + 1));
+    if(cells == NULL || bits == NULL || (root->count != NULL && (count == NULL || tally == NULL || tally_rows == NULL)) || frames == NULL || base == NULL) {
+        printf("Error allocating worker state\n");
+    } else {
+        board.cells = cells;
+        board.rbits = bits;
+        board.cbits = bits + MAX_SIDELENGTH;
+        board.bbits = bits + 2 * MAX_SIDELENGTH;
+        board.filled = root->filled != NULL ? bits + 3 * MAX_SIDELENGTH : NULL;
+        board.count = count;
+        board.tally = tally;
+        board.tally_rows = tally_rows;
+        board.path = NULL;
+        int mark = trail_mark();
+        board.trail_base = mark;
+        work_t *item;
+        while((item = take_work(st)) != NULL) {
+            double copy_start = stats_copy_begin();
+            short int zeroes = replay(st, &board, item);
+            stats_copy_end(copy_start);
+            if(zeroes >= 0) {
+                stats_search_begin();
+                st->search(st, &board, frames, base, item, zeroes, split_nodes);
+                stats_search_end();
+            }
+            // A checkpoint counts every solution found in the subtrees no longer in the pool
+            solutions_flush();
+            trail_undo(NULL, mark);
+            free(item);
+            finish_work(st);
+        }
+        solutions_flush();
+    }
+    free(cells);
+    free(bits);
+    free(count);
+    free(tally);
+    free(tally_rows);
+    free(frames);
+    free(base);
+}
+
+/**
+ * @brief Solves the board with a work-stealing search over the threads of the team.
+ *
+ * Seeds the pool with the root cell and runs a worker on the calling thread. One helper
+ * task per other thread of the team joins either right away, or after opts->split_nodes
+ * nodes when that is set. Like solver() it has to be called from inside a parallel region.
+ *
+ * @param ua The array of unassigned cells built by board_init().
+ * @param board A pointer to the Sudoku board structure.
+ * @param zeroes The number of empty cells left.
+ * @return true if a solution is found, false otherwise.
+ */
+bool steal_solver(ua_t *ua, board_t *board, short int zeroes) {
+    if(zeroes == 0) {
+        report_solution(board);
+        return true;
+    }
+    frontier_t *resume = board->opts->resume;
+    ua_t cell;
+    if(resume == NULL && !select_cell(ua, board, zeroes, &cell)) {
+        return false;
+    }
+    work_t *root = resume == NULL ? malloc(sizeof(work_t)) : NULL;
+    steal_t *st = malloc(sizeof(steal_t));
+    if((resume == NULL && root == NULL) || st == NULL) {
+        printf("Error allocating work item\n");
+        free(root);
+        free(st);
+        return false;
+    }
+
+    st->ua = ua;
+    st->root = board;
+    st->root_zeroes = zeroes;
+    omp_init_lock(&st->lock);
+    memset(st->pool, 0, sizeof(st->pool));
+    st->pool_size = 0;
+    st->active = 0;
+    st->hungry = 0;
+    st->helpers = omp_get_num_threads() - 1;
+    st->search = search_variant(board->base);
+    st->next_checkpoint = omp_get_wtime() + board->opts->checkpoint_seconds;
+    st->checkpointing = 0;
+    st->interrupted = 0;
+    if(resume != NULL) {
+        // The items keep the order they were written in, the deepest subtrees first
+        st->pool[affinity_node()] = resume->items;
+        st->pool_size = resume->count;
+        atomic_store(&board->search->solutions, resume->solutions);
+        resume->items = NULL;
+        resume->count = 0;
+    } else {
+        root->cell = cell;
+        root->remaining = candidates(board, cell.x, cell.y);
+        root->depth = 0;
+        push_work(st, root);
+    }
+
+    long split_nodes = board->opts->split_nodes;
+    if(split_nodes <= 0) {
+        spawn_helpers(st);
+    }
+    worker(st, split_nodes);
+    #pragma omp taskwait
+
+    // A solution ends the search early, drop the work left in the pool
+    for(int node = 0; node < MAX_NODES; node++) {
+        while(st->pool[node] != NULL) {
+            work_t *next = st->pool[node]->next;
+            free(st->pool[node]);
+            st->pool[node] = next;
+        }
+    }
+    // A finished search has nothing left to resume
+    if(board->opts->checkpoint != NULL && !st->interrupted) {
+        remove(board->opts->checkpoint);
+    }
+    omp_destroy_lock(&st->lock);
+    free(st);
+    return search_done(board->search);
+}
+
+/**
+ * @brief Asks the running work-stealing searches for a last checkpoint, after which they stop.
+ *
+ * Only sets a flag, so it can be installed as the handler of SIGTERM and SIGINT.
+ */
+void steal_interrupt(int signal) {
+    (void)signal;
+    interrupt_requested = 1;
+}
+
+/**
+ * @brief Returns whether a search was stopped by steal_interrupt().
+ */
+bool steal_interrupted(void) {
+    return interrupt_requested;
+}
+
+/**
+ * @brief Returns the number of checkpoints written since the program started.
+ */
+long steal_checkpoints(void) {
+    return checkpoints_written;
+}
@@ -0,0 +1,12 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "solver.h"
+#pragma once
+
+bool steal_solver(ua_t *ua, board_t *board, short int zeroes);
+
+void steal_interrupt(int signal);
+
+bool steal_interrupted(void);
+
+long steal_checkpoints(void);
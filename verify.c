@@ -3,68 +3,177 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <omp.h>
 #include "verify.h"
+#include "board.h"
 #define MAX_SIDELENGTH 64
 
-bool verify_row(unsigned char (*board)[MAX_SIDELENGTH], unsigned char row, unsigned char column, unsigned char value, unsigned char sidelength) {
-    for(int i = 0; i < sidelength; i++) {
-        if(i == column) {
-            continue;
-        }
-        if(board[row][i] == value) {
-            return false;
+// Solutions read and checked at once by verify_batch()
+#define VERIFY_CHUNK 1024
+
+typedef struct {
+    unsigned char base;
+    unsigned char sidelength;
+    unsigned char grid[MAX_SIDELENGTH][MAX_SIDELENGTH];
+} solution_t;
+
+/**
+ * @brief Builds the occupancy masks of a range of rows in one pass.
+ *
+ * Every cell sets the bit of its value in the mask of its row, its column and its block. Cells
+ * outside 1..sidelength set an arbitrary bit and are reported through the return value instead.
+ * The columns are walked block by block so that the row and column updates of a block are a
+ * plain loop over contiguous cells that the compiler can vectorize.
+ *
+ * @param grid The cells.
+ * @param base The base of the board.
+ * @param first The first row.
+ * @param last One past the last row.
+ * @param columns The masks of the columns, the bits of the rows are added.
+ * @param blocks The masks of the blocks, the bits of the rows are added.
+ *
+ * @return false if some row of the range is not full or holds a value out of range.
+ */
+static inline bool verify_rows(unsigned char (*grid)[MAX_SIDELENGTH], int base, int first, int last, uint64_t *columns, uint64_t *blocks) {
+    int sidelength = base * base;
+    uint64_t full = full_mask(sidelength);
+    bool valid = true;
+    for(int i = first; i < last; i++) {
+        uint64_t row = 0;
+        unsigned int out_of_range = 0;
+        int block_row = (i / base) * base;
+        for(int b = 0; b < base; b++) {
+            uint64_t block = 0;
+            for(int j = b * base; j < (b + 1) * base; j++) {
+                // 0 wraps around to a large value, so one unsigned compare checks the range
+                unsigned int value = grid[i][j] - 1u;
+                out_of_range |= value >= (unsigned int)sidelength;
+                uint64_t bit = (uint64_t)1 << (value & 63);
+                block |= bit;
+                columns[j] |= bit;
+            }
+            blocks[block_row + b] |= block;
+            row |= block;
         }
+        valid &= !out_of_range && row == full;
     }
-    return true;
+    return valid;
 }
 
-bool verify_column(unsigned char (*board)[MAX_SIDELENGTH], unsigned char row, unsigned char column, unsigned char value, unsigned char sidelength) {
-    for(int i = 0; i < sidelength; i++) {
-        if(i == row) {
-            continue;
-        }
-        if(board[i][column] == value) {
-            return false;
+/**
+ * @brief Checks that a grid is a complete and valid Sudoku solution.
+ *
+ * A single pass builds the occupancy mask of every row, column and block. A unit of sidelength
+ * cells covers all sidelength values exactly when its mask is full, so that is the whole check.
+ *
+ * @param grid The cells.
+ * @param base The base of the board, the side length is base * base.
+ * @param nthreads Threads to split the rows over, 1 checks on the calling thread.
+ *
+ * @return true if every cell is filled and no unit contains a value twice.
+ */
+bool verify_grid(unsigned char (*grid)[MAX_SIDELENGTH], int base, int nthreads) {
+    int sidelength = base * base;
+    uint64_t full = full_mask(sidelength);
+    uint64_t columns[MAX_SIDELENGTH] = {0};
+    uint64_t blocks[MAX_SIDELENGTH] = {0};
+    bool valid = true;
+    if(nthreads > 1) {
+        #pragma omp parallel for num_threads(nthreads) reduction(|:columns[:sidelength], blocks[:sidelength]) reduction(&&:valid)
+        for(int i = 0; i < sidelength; i++) {
+            valid = verify_rows(grid, base, i, i + 1, columns, blocks) && valid;
         }
+    } else {
+        valid = verify_rows(grid, base, 0, sidelength, columns, blocks);
+    }
+    for(int k = 0; k < sidelength; k++) {
+        valid &= columns[k] == full && blocks[k] == full;
     }
-    return true;
+    return valid;
 }
 
-bool verify_square(unsigned char (*board)[MAX_SIDELENGTH], unsigned char row, unsigned char column, unsigned char value, unsigned char base) {
-    unsigned char start_row = row - row % base;
-    unsigned char start_column = column - column % base;
-    for(int i = 0; i < base; i++) {
-        for(int j = 0; j < base; j++) {
-            if (i + start_row == row && j + start_column == column) {
-                continue;
-            }
-            if(board[i + start_row][j + start_column] == value) {
-                return false;
-            }
+/**
+ * @brief Checks that the cells of a board are a complete and valid solution.
+ */
+bool verify(const board_t *board) {
+    return verify_grid(board->board, board->base, 1);
+}
+
+/**
+ * @brief Reads one board in the .dat layout without building any search state.
+ *
+ * @return 1 on success, EOF at the end of the stream, 0 on a malformed board.
+ */
+static int read_solution(FILE *file, solution_t *solution) {
+    if(fread(&solution->base, sizeof(unsigned char), 1, file) != 1) {
+        return EOF;
+    }
+    if(fread(&solution->sidelength, sizeof(unsigned char), 1, file) != 1) {
+        return 0;
+    }
+    int sidelength = solution->sidelength;
+    if(sidelength != solution->base * solution->base || sidelength > MAX_SIDELENGTH) {
+        return 0;
+    }
+    for(int i = 0; i < sidelength; i++) {
+        if(fread(solution->grid[i], sizeof(unsigned char), sidelength, file) != (size_t)sidelength) {
+            return 0;
         }
     }
-    return true;
+    return 1;
 }
 
-bool verify(board_t board_data) {
-    unsigned char (*board)[MAX_SIDELENGTH] = board_data.board;
-    unsigned char base = board_data.base;
-    unsigned char sidelength = board_data.sidelength;
-    for(int i = 0; i < sidelength; i++) {
-        for(int j = 0; j < sidelength; j++) {
-            if(board[i][j] == 0) {
-                return false;
-            }
-            if(verify_row(board, i, j, board[i][j], sidelength) == false) {
-                return false;
-            }
-            if(verify_column(board, i, j, board[i][j], sidelength) == false) {
-                return false;
-            }
-            if(verify_square(board, i, j, board[i][j], base) == false) {
-                return false;
+/**
+ * @brief Checks every board of a stream of back to back .dat boards.
+ *
+ * Boards are read in chunks of VERIFY_CHUNK and the boards of a chunk are checked in
+ * parallel, one board per iteration. One line "<index> valid" or "<index> invalid" is
+ * printed per board in input order, the count and the throughput go to stderr.
+ *
+ * @param file The stream to read the boards from.
+ * @param nthreads The number of threads.
+ *
+ * @return 1 if the stream was read to the end and every board is a valid solution, 0 otherwise.
+ */
+int verify_batch(FILE *file, int nthreads) {
+    solution_t *chunk = malloc(sizeof(solution_t) * VERIFY_CHUNK);
+    bool valid[VERIFY_CHUNK];
+    if(chunk == NULL) {
+        printf("Error allocating solutions\n");
+        return 0;
+    }
+    double time = omp_get_wtime();
+    long n_boards = 0;
+    long n_valid = 0;
+    int status = 1;
+    bool more = true;
+    while(more) {
+        int n = 0;
+        while(n < VERIFY_CHUNK) {
+            int read = read_solution(file, &chunk[n]);
+            if(read != 1) {
+                if(read == 0) {
+                    printf("Error reading board %ld\n", n_boards + n);
+                    status = 0;
+                }
+                more = false;
+                break;
             }
+            n++;
         }
+        #pragma omp parallel for num_threads(nthreads) schedule(dynamic, 16)
+        for(int k = 0; k < n; k++) {
+            valid[k] = verify_grid(chunk[k].grid, chunk[k].base, 1);
+        }
+        for(int k = 0; k < n; k++) {
+            printf("%ld %s\n", n_boards + k, valid[k] ? "valid" : "invalid");
+            n_valid += valid[k];
+        }
+        n_boards += n;
     }
-    return true;
-}
\ No newline at end of file
+    time = omp_get_wtime() - time;
+    fprintf(stderr, "Boards: %ld valid: %ld Nthreads: %d time taken: %f seconds (%.1f boards/s)\n",
+            n_boards, n_valid, nthreads, time, time > 0 ? n_boards / time : 0.0);
+    free(chunk);
+    return status && n_valid == n_boards;
+}
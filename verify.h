@@ -1,6 +1,11 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <omp.h>
 #include "solver.h"
 
-bool verify(board_t board);
\ No newline at end of file
+bool verify_grid(unsigned char (*grid)[MAX_SIDELENGTH], int base, int nthreads);
+
+bool verify(const board_t *board);
+
+int verify_batch(FILE *file, int nthreads);